@@ -5,19 +5,34 @@
 #include <condition_variable>
 #include <mutex>
 #include <sys/time.h>
+#include <chrono>
+#include <utility>
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 using namespace std;
 
+// useEventFd为true时队列额外带一个eventfd，可以和socket一起挂到epoll上等：
+// 队列由空变不空时写一次，取空时读掉，中间再放多少个都不再写，所以fd可读当且仅当队列里有东西；
+// 事件循环收到EPOLLIN后用pop_bulk(items, n, 0)不等待地取走，没取完的话（水平触发）下一轮还会报可读
+// 关闭队列时也会写一次，让事件循环醒来发现pop返回false
 template<typename T>
 class BlockQueue{
       public:
-              explicit BlockQueue(size_t maxSize = 1000);
+              explicit BlockQueue(size_t maxSize = 1000, bool useEventFd = false);
               ~BlockQueue();
               bool empty();
               bool full();
               void push_back(const T& item);
+              void push_back(T&& item);
+              template<typename... Args> void emplace_back(Args&&... args);//直接在队列里构造
               void push_front(const T& item);
-              bool pop(T& item);//弹出的任务放入item
+              bool pop(T& item);//弹出的任务移动到item
               bool pop(T& item, int timeout);//等待时间
+              //等到有元素（timeout毫秒，小于0一直等），一次加锁把现有的最多maxItems个都移动到items末尾
+              //返回取到的个数，超时或者队列关闭返回0
+              template<typename Container> size_t pop_bulk(Container& items, size_t maxItems, int timeout = -1);
               void clear();
               T front();
               T back();
@@ -26,26 +41,37 @@ class BlockQueue{
 
               void flush();
               void close();//关闭队列
+              int event_fd();//没有开eventfd或者创建失败时返回-1
 
 private:
+              void Pushed_();//放进一个元素之后调用，要持有mutex_
+              void Popped_();//取走元素之后调用，要持有mutex_
+
               deque<T> deq_;//底层数据结构
               mutex mutex_;//互斥锁
               bool isClose_;//是否关闭
               size_t capacity_;//队列最大容量
               condition_variable condConsumer_;//消费者条件变量
               condition_variable condProducer_;//生产者条件变量
+              int eventFd_;//-1表示不用eventfd
 };
 
 // 队列的构造函数
 template<typename T>
-BlockQueue<T>::BlockQueue(size_t maxSize) : capacity_(maxSize){
+BlockQueue<T>::BlockQueue(size_t maxSize, bool useEventFd) : capacity_(maxSize), eventFd_(-1){
       assert(maxSize > 0);
       isClose_ = false;
+      if(useEventFd){
+            eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      }
 }
 
 template<typename T>
 BlockQueue<T>::~BlockQueue(){
       close();
+      if(eventFd_ >= 0){
+            ::close(eventFd_);
+      }
 }
 
 //判断队列是否为空
@@ -68,7 +94,15 @@ void BlockQueue<T>::close(){
       // lock_guard<mutex> locker(mtx_); // 操控队列之前，都需要上锁
       // deq_.clear();                   // 清空队列
       clear();
-      isClose_ = true;               // 设置关闭标志
+      {
+            lock_guard<mutex> locker(mutex_);
+            isClose_ = true;               // 设置关闭标志
+            if(eventFd_ >= 0){
+                  uint64_t one = 1;
+                  ssize_t n = ::write(eventFd_, &one, sizeof(one));// 唤醒在epoll上等的事件循环
+                  (void)n;
+            }
+      }
       condConsumer_.notify_all();    // 唤醒所有消费者
       condProducer_.notify_all();    // 唤醒所有生产者
 }
@@ -77,6 +111,7 @@ template<typename T>
 void BlockQueue<T>::clear(){
       lock_guard<mutex> locker(mutex_);
       deq_.clear();
+      Popped_();
 }
 
 template<typename T>
@@ -87,7 +122,28 @@ void BlockQueue<T>::push_back(const T& item){
             condProducer_.wait(locker);//暂停生产，等待消费者唤醒生产条件变量
       }
       deq_.push_back(item);//将item放入队列
-      condConsumer_.notify_one();//唤醒一个消费者
+      Pushed_();
+}
+
+template<typename T>
+void BlockQueue<T>::push_back(T&& item){
+      unique_lock<mutex> locker(mutex_);
+      while(deq_.size() >= capacity_){ // 如果队列满了，生产者就等待
+            condProducer_.wait(locker);
+      }
+      deq_.push_back(std::move(item));//移动进队列，不拷贝
+      Pushed_();
+}
+
+template<typename T>
+template<typename... Args>
+void BlockQueue<T>::emplace_back(Args&&... args){
+      unique_lock<mutex> locker(mutex_);
+      while(deq_.size() >= capacity_){ // 如果队列满了，生产者就等待
+            condProducer_.wait(locker);
+      }
+      deq_.emplace_back(std::forward<Args>(args)...);
+      Pushed_();
 }
 
 template<typename T>
@@ -97,7 +153,7 @@ void BlockQueue<T>::push_front(const T& item){
             condProducer_.wait(locker);//暂停生产，等待消费者唤醒生产条件变量
       }
       deq_.push_front(item);
-      condConsumer_.notify_one();//唤醒一个消费者
+      Pushed_();
 }
 
 
@@ -110,8 +166,9 @@ bool BlockQueue<T>::pop(T& item){
       if(isClose_){
             return false;
       }
-      item = deq_.front();//获取队首元素
+      item = std::move(deq_.front());//移走队首元素
       deq_.pop_front();//移除队首元素
+      Popped_();
       condProducer_.notify_one();//唤醒一个生产者
       return true;
 }
@@ -127,12 +184,44 @@ bool BlockQueue<T>::pop(T& item, int timeout){
       if(isClose_){
             return false;
       }
-      item = deq_.front();//获取队首元素
+      item = std::move(deq_.front());//移走队首元素
       deq_.pop_front();//移除队首元素
+      Popped_();
       condProducer_.notify_one();//唤醒一个生产者
       return true;
 }
 
+template<typename T>
+template<typename Container>
+size_t BlockQueue<T>::pop_bulk(Container& items, size_t maxItems, int timeout){
+      std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+      unique_lock<mutex> locker(mutex_);
+      while(deq_.empty() && !isClose_){ // 如果队列空了，消费者就等待
+            if(timeout < 0){
+                  condConsumer_.wait(locker);
+            }else if(condConsumer_.wait_until(locker, deadline) == std::cv_status::timeout){
+                  return 0;
+            }
+      }
+      if(isClose_){
+            return 0;
+      }
+      size_t n = 0;
+      while(n < maxItems && !deq_.empty()){
+            items.push_back(std::move(deq_.front()));
+            deq_.pop_front();
+            n++;
+      }
+      Popped_();
+      if(n > 1){
+            condProducer_.notify_all();//空出了多个位置
+      }else{
+            condProducer_.notify_one();
+      }
+      return n;
+}
+
 template<typename T>
 T BlockQueue<T>::front(){
       lock_guard<mutex> locker(mutex_);
@@ -161,4 +250,29 @@ template<typename T>
 void BlockQueue<T>::flush(){
       condConsumer_.notify_one();
 }
+
+template<typename T>
+int BlockQueue<T>::event_fd(){
+      return eventFd_;
+}
+
+//两次系统调用都在锁里做，写和读的先后跟队列的空和不空一致，不会留下一个没人管的可读状态
+template<typename T>
+void BlockQueue<T>::Pushed_(){
+      condConsumer_.notify_one();//唤醒一个消费者
+      if(eventFd_ >= 0 && deq_.size() == 1){//由空变不空，通知合并成一次
+            uint64_t one = 1;
+            ssize_t n = ::write(eventFd_, &one, sizeof(one));
+            (void)n;
+      }
+}
+
+template<typename T>
+void BlockQueue<T>::Popped_(){
+      if(eventFd_ >= 0 && deq_.empty() && !isClose_){//取空了，把计数读掉，fd不再可读
+            uint64_t count;
+            ssize_t n = ::read(eventFd_, &count, sizeof(count));
+            (void)n;
+      }
+}
 #endif
\ No newline at end of file
@@ -1,32 +1,87 @@
 #include "buffer.h"
+#include "uringio.h"
 #include <sys/uio.h>
+#include <sys/sendfile.h>
+
+std::atomic<int> Buffer::ioBackend_(Buffer::READV);
+std::atomic<bool> Buffer::uringUsed_(false);
+
+bool Buffer::SetIoBackend(IoBackend backend) {
+    if (backend == URING && !UringIO::Instance()->Available()) {
+        ioBackend_ = READV;//内核不支持，继续用readv/write
+        return false;
+    }
+    if (backend == URING) {
+        uringUsed_ = true;
+    }
+    ioBackend_ = backend;
+    return true;
+}
+
+void Buffer::ForgetFd(int fd) {
+    if (uringUsed_) {
+        UringIO::Instance()->Forget(fd);
+    }
+}
+
+Buffer::IoBackend Buffer::GetIoBackend() {
+    return static_cast<IoBackend>(ioBackend_.load());
+}
 
 //都是读到可写区，写入fd是从读区readable开始写入
 // 构造函数，初始化缓冲区大小和读写位置
-Buffer::Buffer(int size) : buffer_(size), readIndex_(0), writeIndex_(0) {}
+Buffer::Buffer(int size, Mode mode)
+    : mode_(mode), chainBytes_(0), pinCount_(0), buffer_(mode == CHAINED ? 0 : size), readIndex_(0), writeIndex_(0) {}
+
+// 分段模式下把所有块还给SlabPool
+Buffer::~Buffer() {
+    chainReleaseAll();
+}
 
 // 返回可写字节数
 size_t Buffer::WritableBytes() const {
+    if (mode_ == CHAINED) {
+        return chainTailWritable();
+    }
     return buffer_.size() - writeIndex_;
 }
 
 // 返回可读字节数
 size_t Buffer::ReadableBytes() const {
+    if (mode_ == CHAINED) {
+        return chainBytes_;
+    }
     return writeIndex_ - readIndex_;
 }
 
 // 返回预留空间
 size_t Buffer::prependableBytes() const {
+    if (mode_ == CHAINED) {
+        return chain_.empty() || isFile(chain_.front()) ? 0 : chain_.front().read;
+    }
     return readIndex_;
 }
 
-// 返回当前读指针位置
+// 返回当前读指针位置，分段模式下只保证第一段连续
 const char* Buffer::peek() const {
+    if (mode_ == CHAINED) {
+        static const char empty[1] = {0};
+        return chain_.empty() || isFile(chain_.front()) ? empty : chain_.front().data + chain_.front().read;
+    }
     return &buffer_[readIndex_];
 }
 
 // 确保有足够空间写入数据
 void Buffer::ensureWritableBytes(size_t len) {
+    if (mode_ == CHAINED) {
+        // 分段模式下只能保证一块以内的连续空间，新开一块，不搬移已有数据
+        assert(len <= SlabPool::SLAB_SIZE);
+        if (chainTailWritable() < len) {
+            Slab slab = {SlabPool::Instance()->Alloc(), 0, 0, -1, 0, false};
+            chain_.push_back(slab);
+        }
+        return;
+    }
     if (WritableBytes() < len) {
         makeSpace(len);
     }
@@ -35,12 +90,22 @@ void Buffer::ensureWritableBytes(size_t len) {
 
 // 写入数据后移动写指针
 void Buffer::HasWritten(size_t len) {
+    if (mode_ == CHAINED) {
+        assert(len <= chainTailWritable());
+        chain_.back().write += len;
+        chainBytes_ += len;
+        return;
+    }
     writeIndex_ += len;
 }
 
 // 读取 len 字节后移动读指针
 void Buffer::retrieve(size_t len) {
     assert(len <= ReadableBytes());
+    if (mode_ == CHAINED) {
+        chainRetrieve(len);
+        return;
+    }
     readIndex_ += len;
 }
 
@@ -52,12 +117,43 @@ void Buffer::retrieveUntil(const char* end) {
 
 // 清空所有内容并重置指针,读写下标归零,在别的函数中会用到
 void Buffer::retrieveAll() {
+    if (mode_ == CHAINED) {
+        chainReleaseAll();
+        return;
+    }
+    if (pinCount_ > 0) {//钉住时只移动读指针，数据原地保留
+        readIndex_.store(writeIndex_.load());
+        return;
+    }
     memset(buffer_.data(), 0, buffer_.size());
     readIndex_ = writeIndex_ = 0;
 }
 
+void Buffer::Pin() {
+    assert(mode_ == CONTIGUOUS);
+    pinCount_++;
+}
+
+void Buffer::Unpin() {
+    assert(pinCount_ > 0);
+    pinCount_--;
+}
+
 // 取出剩余可读的str
 std::string Buffer::retrieveAllToString() {
+    if (mode_ == CHAINED) {
+        std::string str;
+        str.reserve(chainBytes_);
+        for (const Slab& slab : chain_) {
+            if (isFile(slab)) {
+                readFileSegment(slab, str);
+            } else {
+                str.append(slab.data + slab.read, slab.write - slab.read);
+            }
+        }
+        retrieveAll();
+        return str;
+    }
     std::string str(peek(), ReadableBytes());
     retrieveAll();
     return str;
@@ -65,11 +161,18 @@ std::string Buffer::retrieveAllToString() {
 
 // 返回写指针位置（const 版本）
 const char* Buffer::BeginWriteConst() const {
+    if (mode_ == CHAINED) {
+        return chain_.empty() || isFile(chain_.back()) ? peek() : chain_.back().data + chain_.back().write;
+    }
     return &buffer_[writeIndex_];
 }
 
 // 返回写指针位置
 char* Buffer::BeginWrite() {
+    if (mode_ == CHAINED) {
+        ensureWritableBytes(1);
+        return chain_.back().data + chain_.back().write;
+    }
     return &buffer_[writeIndex_];
 }
 
@@ -81,6 +184,10 @@ void Buffer::Append(const std::string& str) {
 // 追加 char* 数据
 void Buffer::Append(const char* str, size_t len) {
     assert(str);
+    if (mode_ == CHAINED) {
+        chainAppend(str, len);
+        return;
+    }
     ensureWritableBytes(len);
     std::copy(str, str + len, BeginWrite());
     HasWritten(len);
@@ -93,11 +200,36 @@ void Buffer::Append(const void* data, size_t len) {
 
 //主要功能时将另一个Buffer对象中的可读数据追加到当前Buffer对象中
 void Buffer::Append(const Buffer& buffer){
+    if(buffer.mode_ == CHAINED)
+    {
+        for(const Slab& slab : buffer.chain_)
+        {
+            if(isFile(slab))
+            {
+                std::string content;
+                readFileSegment(slab, content);
+                Append(content);
+            }
+            else
+            {
+                Append(slab.data + slab.read, slab.write - slab.read);
+            }
+        }
+        return;
+    }
     Append(buffer.peek(), buffer.ReadableBytes());
 }
 
 //将fd的内容读到缓冲区，既要读到writable的位置
 ssize_t Buffer::ReadFd(int fd,int* Errno){
+    if(ioBackend_ == URING)
+    {
+        return UringIO::Instance()->Recv(fd, *this, Errno);
+    }
+    if(mode_ == CHAINED)
+    {
+        return chainReadFd(fd, Errno);
+    }
     char extraBuf[65536];//栈区
     struct iovec iov[2];
     size_t writeable = WritableBytes();//先记录能写多少
@@ -126,6 +258,20 @@ ssize_t Buffer::ReadFd(int fd,int* Errno){
 
 
 ssize_t Buffer::WriteFd(int fd, int* Errno){
+    if(mode_ == CHAINED)
+    {
+        return chainWriteFd(fd, Errno);
+    }
+    if(ioBackend_ == URING)
+    {
+        struct iovec iov = {const_cast<char*>(peek()), ReadableBytes()};
+        ssize_t len = UringIO::Instance()->Send(fd, &iov, 1, Errno);
+        if(len > 0)
+        {
+            retrieve(len);
+        }
+        return len;
+    }
     ssize_t len = write(fd,peek(),ReadableBytes());//从读区开始写入
     if(len < 0)
     {
@@ -145,7 +291,7 @@ const char* Buffer::BeginPtr() const {
 }
 
 void Buffer::makeSpace(size_t len){
-    if(WritableBytes() + prependableBytes() < len)//第一种情况:需要扩容
+    if(pinCount_ > 0 || WritableBytes() + prependableBytes() < len)//第一种情况:需要扩容（钉住时只能扩容，不能搬移）
     {
         buffer_.resize(writeIndex_ + len + 1);
     }
@@ -159,4 +305,283 @@ void Buffer::makeSpace(size_t len){
         writeIndex_ = readable;
         assert(readable == ReadableBytes());
     }
-}
\ No newline at end of file
+}
+
+//分段模式下尾块还能写多少
+size_t Buffer::chainTailWritable() const{
+    if(chain_.empty() || isFile(chain_.back()))//文件段后面不能再写内存数据，要另开一块
+    {
+        return 0;
+    }
+    return SlabPool::SLAB_SIZE - chain_.back().write;
+}
+
+//分段追加：先填满尾块，不够再从SlabPool取新块，已有的数据一个字节都不动
+void Buffer::chainAppend(const char* str, size_t len){
+    while(len > 0)
+    {
+        size_t writable = chainTailWritable();
+        if(writable == 0)
+        {
+            Slab slab = {SlabPool::Instance()->Alloc(), 0, 0, -1, 0, false};
+            chain_.push_back(slab);
+            writable = SlabPool::SLAB_SIZE;
+        }
+        size_t n = len < writable ? len : writable;
+        Slab& tail = chain_.back();
+        std::copy(str, str + n, tail.data + tail.write);
+        tail.write += n;
+        chainBytes_ += n;
+        str += n;
+        len -= n;
+    }
+}
+
+//从头部取走len字节，读空的块立刻还给SlabPool
+void Buffer::chainRetrieve(size_t len){
+    while(len > 0)
+    {
+        Slab& head = chain_.front();
+        size_t readable = head.write - head.read;
+        size_t n = len < readable ? len : readable;
+        head.read += n;
+        chainBytes_ -= n;
+        len -= n;
+        if(head.read == head.write && isFile(head))//文件段发完了
+        {
+            if(head.ownFd)
+            {
+                close(head.fd);
+            }
+            chain_.pop_front();
+        }
+        else if(head.read == head.write && (chain_.size() > 1 || head.write == SlabPool::SLAB_SIZE))
+        {
+            SlabPool::Instance()->Free(head.data);
+            chain_.pop_front();
+        }
+    }
+    if(chainBytes_ == 0 && chain_.size() == 1 && !isFile(chain_.front()))//只剩一块空块，读写位置归零继续复用
+    {
+        chain_.front().read = chain_.front().write = 0;
+    }
+}
+
+void Buffer::chainReleaseAll(){
+    for(const Slab& slab : chain_)
+    {
+        if(!isFile(slab))
+        {
+            SlabPool::Instance()->Free(slab.data);
+        }
+        else if(slab.ownFd)
+        {
+            close(slab.fd);
+        }
+    }
+    chain_.clear();
+    chainBytes_ = 0;
+}
+
+//分段读：iov直接指向尾块剩余空间和几块新取的slab，内核把数据直接读进块里，不再经过栈上临时缓冲区
+ssize_t Buffer::chainReadFd(int fd, int* Errno){
+    static const int kReadSlabs = 4;//和原来64KB的extraBuf容量相当
+    struct iovec iov[kReadSlabs + 1];
+    char* fresh[kReadSlabs];
+    int cnt = 0;
+    size_t tailWritable = chainTailWritable();
+    if(tailWritable > 0)
+    {
+        iov[cnt].iov_base = chain_.back().data + chain_.back().write;
+        iov[cnt].iov_len = tailWritable;
+        cnt++;
+    }
+    for(int i = 0; i < kReadSlabs; i++)
+    {
+        fresh[i] = SlabPool::Instance()->Alloc();
+        iov[cnt].iov_base = fresh[i];
+        iov[cnt].iov_len = SlabPool::SLAB_SIZE;
+        cnt++;
+    }
+
+    ssize_t len = readv(fd, iov, cnt);
+    if(len < 0)
+    {
+        *Errno = errno;
+    }
+    size_t left = len > 0 ? static_cast<size_t>(len) : 0;
+    chainBytes_ += left;
+    if(tailWritable > 0)
+    {
+        size_t n = left < tailWritable ? left : tailWritable;
+        chain_.back().write += n;
+        left -= n;
+    }
+    for(int i = 0; i < kReadSlabs; i++)
+    {
+        if(left > 0)//读到数据的新块挂到链尾
+        {
+            size_t n = left < SlabPool::SLAB_SIZE ? left : SlabPool::SLAB_SIZE;
+            Slab slab = {fresh[i], 0, n, -1, 0, false};
+            chain_.push_back(slab);
+            left -= n;
+        }
+        else//没用上的块还回去
+        {
+            SlabPool::Instance()->Free(fresh[i]);
+        }
+    }
+    return len;
+}
+
+//分段写：连续的内存块用一次writev发出去，遇到文件段就用sendfile发，写完的块还给SlabPool
+//一直写到全部发完、或者socket写不动为止，返回本次总共写出的字节数
+ssize_t Buffer::chainWriteFd(int fd, int* Errno){
+    static const int kMaxIov = 64;
+    ssize_t total = 0;
+    while(chainBytes_ > 0)
+    {
+        if(isFile(chain_.front()))
+        {
+            size_t remain = chain_.front().write - chain_.front().read;
+            ssize_t len = sendFileSegment(fd, chain_.front(), Errno);
+            if(len < 0)
+            {
+                return total > 0 ? total : len;
+            }
+            retrieve(len);
+            total += len;
+            if(static_cast<size_t>(len) < remain)
+            {
+                break;
+            }
+            continue;
+        }
+
+        struct iovec iov[kMaxIov];
+        int cnt = 0;
+        size_t want = 0;
+        for(const Slab& slab : chain_)
+        {
+            if(cnt == kMaxIov || isFile(slab))
+            {
+                break;
+            }
+            if(slab.write > slab.read)
+            {
+                iov[cnt].iov_base = slab.data + slab.read;
+                iov[cnt].iov_len = slab.write - slab.read;
+                want += iov[cnt].iov_len;
+                cnt++;
+            }
+        }
+        if(cnt == 0)
+        {
+            break;
+        }
+        ssize_t len = 0;
+        if(ioBackend_ == URING)
+        {
+            len = UringIO::Instance()->Send(fd, iov, cnt, Errno);
+        }
+        else
+        {
+            len = writev(fd, iov, cnt);
+            if(len < 0)
+            {
+                *Errno = errno;
+            }
+        }
+        if(len < 0)
+        {
+            return total > 0 ? total : len;
+        }
+        retrieve(len);
+        total += len;
+        if(static_cast<size_t>(len) < want)//socket缓冲区满了
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+//文件段优先走sendfile，内核直接从页缓存发到socket
+//个别文件系统或目标fd不支持sendfile时，退回pread到一块slab再write
+ssize_t Buffer::sendFileSegment(int fd, Slab& slab, int* Errno){
+    size_t remain = slab.write - slab.read;
+    off_t offset = slab.offset + static_cast<off_t>(slab.read);
+    ssize_t len = sendfile(fd, slab.fd, &offset, remain);
+    if(len == 0 && remain > 0)//文件在AppendFile之后被截短了，这段永远发不完，当成错误让调用方关连接
+    {
+        *Errno = EIO;
+        return -1;
+    }
+    if(len >= 0)
+    {
+        return len;
+    }
+    if(errno != EINVAL && errno != ENOSYS)
+    {
+        *Errno = errno;
+        return -1;
+    }
+    char* tmp = SlabPool::Instance()->Alloc();
+    size_t n = remain < SlabPool::SLAB_SIZE ? remain : SlabPool::SLAB_SIZE;
+    len = pread(slab.fd, tmp, n, offset);
+    if(len > 0)
+    {
+        len = write(fd, tmp, static_cast<size_t>(len));
+    }
+    else if(len == 0)//同上，文件变短了
+    {
+        errno = EIO;
+        len = -1;
+    }
+    if(len < 0)
+    {
+        *Errno = errno;
+    }
+    SlabPool::Instance()->Free(tmp);
+    return len;
+}
+
+//把文件段剩余的内容读出来追加到out，只在需要拿到字节内容时（retrieveAllToString等）才会用到
+void Buffer::readFileSegment(const Slab& slab, std::string& out){
+    size_t remain = slab.write - slab.read;
+    size_t old = out.size();
+    out.resize(old + remain);
+    size_t done = 0;
+    while(done < remain)
+    {
+        ssize_t n = pread(slab.fd, &out[old + done], remain - done, slab.offset + static_cast<off_t>(slab.read + done));
+        if(n <= 0)
+        {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    out.resize(old + done);
+}
+
+void Buffer::AppendFile(int fd, off_t offset, size_t len, bool ownFd){
+    assert(mode_ == CHAINED && fd >= 0);
+    if(len == 0)
+    {
+        if(ownFd)
+        {
+            close(fd);
+        }
+        return;
+    }
+    Slab file = {nullptr, 0, len, fd, offset, ownFd};
+    chain_.push_back(file);
+    chainBytes_ += len;
+}
+
+void Buffer::AdoptSlab(char* slab, size_t len){
+    assert(mode_ == CHAINED && slab && len <= SlabPool::SLAB_SIZE);
+    Slab adopted = {slab, 0, len, -1, 0, false};
+    chain_.push_back(adopted);
+    chainBytes_ += len;
+}
@@ -3,15 +3,43 @@
 #include <cstring>   //perror
 #include <iostream>
 #include <unistd.h>  // write
+#include <sys/types.h>
 //#include <sys/uio.h> //readv
 #include <vector> //readv
+#include <deque>
 #include <atomic>
 #include <assert.h>
+#include "slabpool.h"
 
 class Buffer {
 public:
-       Buffer(int size = 1024);
-       ~Buffer()= default;
+       // CONTIGUOUS：原来的单块vector模式，空间不够时扩容或搬移数据
+       // CHAINED：分段模式，由SlabPool里的固定大小块串成链，追加时从不搬移已有数据，
+       //          peek()只保证第一段连续，适合大请求体和大响应，不适合按行解析
+       enum Mode {
+              CONTIGUOUS,
+              CHAINED,
+       };
+
+       Buffer(int size = 1024, Mode mode = CONTIGUOUS);
+       ~Buffer();
+       Buffer(const Buffer&) = delete;
+       Buffer& operator=(const Buffer&) = delete;
+
+       // ReadFd/WriteFd的底层I/O方式，全局生效
+       // READV：readv/write（默认）；URING：io_uring，内核不支持时自动退回READV
+       enum IoBackend {
+              READV,
+              URING,
+       };
+       static bool SetIoBackend(IoBackend backend); // 返回最终是否启用了指定后端
+       static IoBackend GetIoBackend();
+       // 连接关闭时在close(fd)之前调用：io_uring后端取消这个fd上挂着的recv，还回它占着的缓冲区
+       // 不然fd号码被新连接复用后会收到旧连接剩下的数据；从没启用过io_uring时什么也不做
+       static void ForgetFd(int fd);
+
+       bool IsChained() const { return mode_ == CHAINED; }
+       size_t SlabCount() const { return chain_.size(); } // 分段模式下当前占用的块数
 
        size_t WritableBytes() const;
        size_t ReadableBytes() const;
@@ -39,11 +67,57 @@ public:
        ssize_t ReadFd(int fd,int* Errno); // 读取fd的内容到buffer
        ssize_t WriteFd(int fd, int* Errno);// 写入buffer的内容到fd
 
+       // 钉住缓冲区（只用于连续模式，可重入）：钉住期间makeSpace不会把可读数据搬到开头，只会整体扩容，
+       // 已经读过的数据也不会被清掉，于是"相对缓冲区首地址的偏移"始终有效
+       // 零拷贝解析把请求字段记成偏移，请求处理完之前一直钉住
+       void Pin();
+       void Unpin();
+       bool IsPinned() const { return pinCount_ > 0; }
+       size_t OffsetOf(const char* p) const { return p - BeginPtr(); } // 指针 -> 相对首地址的偏移
+       const char* AtOffset(size_t offset) const { return BeginPtr() + offset; } // 偏移 -> 指针（扩容后要重新取）
+
+       // 分段模式下追加一个文件段：fd上从offset开始的len字节，WriteFd时用sendfile直接从页缓存发出，
+       // 不经过用户态；ownFd为true时文件段发完（或Buffer清空）后由Buffer负责close
+       // 队首是文件段时peek()拿不到它的内容，ReadableBytes()会把文件段的长度算进去
+       void AppendFile(int fd, off_t offset, size_t len, bool ownFd = false);
+
+       // 分段模式下把一块已经写好len字节数据的slab直接挂到链尾，所有权交给Buffer
+       // 供I/O后端使用（内核直接读进slab），避免再拷贝一次
+       void AdoptSlab(char* slab, size_t len);
+
 private:
        char* BeginPtr();// 返回缓冲区首地址
        const char* BeginPtr( ) const;
        void makeSpace(size_t len);// 扩展空间
 
+       // 分段模式下的一块，[read, write)为可读区，[write, SlabPool::SLAB_SIZE)为可写区
+       // data为空时是文件段：内容是fd上[offset + read, offset + write)这一段，不占用户态内存
+       struct Slab {
+              char* data;
+              size_t read;
+              size_t write;
+              int fd;
+              off_t offset;
+              bool ownFd;
+       };
+       static bool isFile(const Slab& slab) { return slab.data == nullptr; }
+       static void readFileSegment(const Slab& slab, std::string& out);
+       ssize_t sendFileSegment(int fd, Slab& slab, int* Errno);
+       void chainAppend(const char* str, size_t len);
+       void chainRetrieve(size_t len);
+       void chainReleaseAll();
+       size_t chainTailWritable() const;
+       ssize_t chainReadFd(int fd, int* Errno);
+       ssize_t chainWriteFd(int fd, int* Errno);
+
+       static std::atomic<int> ioBackend_;
+       static std::atomic<bool> uringUsed_; // 启用过io_uring后端，之后切回READV也可能还有fd挂在环上
+
+       Mode mode_;
+       std::deque<Slab> chain_; // 分段模式下的块链
+       size_t chainBytes_;      // 分段模式下的可读字节总数
+       int pinCount_;           // 钉住计数，大于0时不搬移数据
+
        std::vector<char> buffer_; // 缓冲区
        std::atomic<size_t> readIndex_; // 读下标
        std::atomic<size_t> writeIndex_; // 写下标
@@ -0,0 +1,355 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <new>
+#include <utility>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <climits>
+#include <stdint.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// 有界多生产者多消费者无锁队列（Vyukov的带序号环形数组），常用接口和BlockQueue一样，可以直接替换
+// 每个槽带一个序号：序号==位置 表示槽空着可以写，序号==位置+1 表示有数据可以读；
+// 生产者和消费者各自用CAS抢位置，不加锁，也不通知
+// 空了（或满了）先自旋一会儿，再让出几次CPU，还不行才在futex上睡；只有确实有人在睡，对面才发系统调用叫醒
+// 容量向上取到2的幂；没有push_front、front、back：环只能从尾部放、头部取，并发下读队首队尾的值也没有意义
+template<typename T>
+class LockFreeQueue{
+      public:
+              explicit LockFreeQueue(size_t maxSize = 1000);
+              ~LockFreeQueue();
+              bool empty();
+              bool full();
+              void push_back(const T& item);
+              void push_back(T&& item);
+              template<typename... Args> void emplace_back(Args&&... args);
+              bool pop(T& item);//弹出的元素移动到item里
+              bool pop(T& item, int timeout);//最多等timeout毫秒
+              //等到有元素（timeout毫秒，小于0一直等），再不等待地把现有的最多maxItems个移动到items末尾，返回个数
+              template<typename Container> size_t pop_bulk(Container& items, size_t maxItems, int timeout = -1);
+              void clear();
+              size_t capacity();
+              size_t size();
+
+              void flush();//叫醒一个在等的消费者
+              void close();//关闭队列，叫醒所有在等的线程
+
+      private:
+              static const int SPIN = 64;//睡之前空转重试的次数
+              static const int YIELDS = 4;//空转之后再让出CPU重试的次数
+
+              struct Cell {
+                    std::atomic<size_t> seq;
+                    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+              };
+
+              template<typename U> bool TryPush_(U&& item);
+              bool TryPop_(T& item);
+              template<typename U> void Push_(U&& item);
+              bool Pop_(T& item, int timeout);//timeout<0时一直等
+              bool Readable_();//队首的槽有数据
+              bool Writable_();//队尾的槽空着
+              static void Pause_();
+              static void Wait_(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeoutNs);//timeoutNs<0时一直等
+              static void Wake_(std::atomic<uint32_t>& word, int count);
+
+              char pad0_[64];
+              std::atomic<size_t> tail_;//下一个要写的位置，生产者抢
+              char pad1_[64];
+              std::atomic<size_t> head_;//下一个要读的位置，消费者抢
+              char pad2_[64];
+              std::atomic<uint32_t> notEmpty_;//futex字：有消费者在睡时，放进数据后加一再叫醒
+              std::atomic<uint32_t> emptyWaiters_;//在notEmpty_上睡（或者正准备睡）的消费者数
+              std::atomic<uint32_t> notFull_;//futex字：有生产者在睡时，取走数据后加一再叫醒
+              std::atomic<uint32_t> fullWaiters_;
+              std::atomic<bool> isClose_;//是否关闭
+              Cell* cells_;
+              size_t mask_;
+};
+
+template<typename T>
+LockFreeQueue<T>::LockFreeQueue(size_t maxSize) : tail_(0), head_(0), notEmpty_(0), emptyWaiters_(0),
+                                                  notFull_(0), fullWaiters_(0), isClose_(false){
+      assert(maxSize > 0);
+      size_t cap = 1;
+      while(cap < maxSize){
+            cap <<= 1;
+      }
+      cells_ = new Cell[cap];
+      for(size_t i = 0; i < cap; i++){
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+      }
+      mask_ = cap - 1;
+}
+
+template<typename T>
+LockFreeQueue<T>::~LockFreeQueue(){
+      close();
+      //close之后还可能有生产者在关闭前抢到了槽、放进了数据；析构时已经没有别的线程，把剩下的析构掉
+      size_t tail = tail_.load(std::memory_order_acquire);
+      for(size_t pos = head_.load(std::memory_order_acquire); pos != tail; pos++){
+            Cell& cell = cells_[pos & mask_];
+            if(cell.seq.load(std::memory_order_acquire) == pos + 1){
+                  reinterpret_cast<T*>(&cell.storage)->~T();
+            }
+      }
+      delete[] cells_;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::empty(){
+      return !Readable_();
+}
+
+template<typename T>
+bool LockFreeQueue<T>::full(){
+      return !Writable_();
+}
+
+template<typename T>
+size_t LockFreeQueue<T>::capacity(){
+      return mask_ + 1;
+}
+
+//生产者和消费者都在动时只是个大概的数
+template<typename T>
+size_t LockFreeQueue<T>::size(){
+      size_t head = head_.load(std::memory_order_acquire);
+      size_t tail = tail_.load(std::memory_order_acquire);
+      return tail > head ? tail - head : 0;
+}
+
+template<typename T>
+void LockFreeQueue<T>::close(){
+      isClose_.store(true);//先关上，新的push不再放数据，再清空
+      clear();
+      notEmpty_.fetch_add(1);
+      notFull_.fetch_add(1);
+      Wake_(notEmpty_, INT_MAX);// 唤醒所有消费者
+      Wake_(notFull_, INT_MAX);// 唤醒所有生产者
+}
+
+template<typename T>
+void LockFreeQueue<T>::clear(){
+      T item;
+      while(TryPop_(item)){
+      }
+      if(fullWaiters_.load() > 0){
+            notFull_.fetch_add(1);
+            Wake_(notFull_, INT_MAX);
+      }
+}
+
+template<typename T>
+void LockFreeQueue<T>::push_back(const T& item){
+      Push_(item);
+}
+
+template<typename T>
+void LockFreeQueue<T>::push_back(T&& item){
+      Push_(std::move(item));
+}
+
+template<typename T>
+template<typename... Args>
+void LockFreeQueue<T>::emplace_back(Args&&... args){
+      Push_(T(std::forward<Args>(args)...));//槽要等抢到才能构造，先在外面造好再移动进去
+}
+
+template<typename T>
+bool LockFreeQueue<T>::pop(T& item){
+      return Pop_(item, -1);
+}
+
+template<typename T>
+bool LockFreeQueue<T>::pop(T& item, int timeout){
+      return Pop_(item, timeout < 0 ? 0 : timeout);
+}
+
+template<typename T>
+template<typename Container>
+size_t LockFreeQueue<T>::pop_bulk(Container& items, size_t maxItems, int timeout){
+      T item;
+      if(maxItems == 0 || !Pop_(item, timeout)){
+            return 0;
+      }
+      items.push_back(std::move(item));
+      size_t n = 1;
+      while(n < maxItems && TryPop_(item)){
+            items.push_back(std::move(item));
+            n++;
+      }
+      if(n > 1 && fullWaiters_.load() > 0){
+            notFull_.fetch_add(1);
+            Wake_(notFull_, INT_MAX);//空出了多个位置
+      }
+      return n;
+}
+
+template<typename T>
+void LockFreeQueue<T>::flush(){
+      notEmpty_.fetch_add(1);
+      Wake_(notEmpty_, 1);
+}
+
+template<typename T>
+template<typename U>
+bool LockFreeQueue<T>::TryPush_(U&& item){
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      while(true){
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if(dif == 0){
+                  if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        new (&cell.storage) T(std::forward<U>(item));
+                        cell.seq.store(pos + 1, std::memory_order_release);//发布给消费者
+                        return true;
+                  }
+            }else if(dif < 0){
+                  return false;//满了：这个槽上一轮的数据还没被取走
+            }else{
+                  pos = tail_.load(std::memory_order_relaxed);//被别的生产者抢先了
+            }
+      }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::TryPop_(T& item){
+      size_t pos = head_.load(std::memory_order_relaxed);
+      while(true){
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if(dif == 0){
+                  if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        T* data = reinterpret_cast<T*>(&cell.storage);
+                        item = std::move(*data);
+                        data->~T();
+                        cell.seq.store(pos + mask_ + 1, std::memory_order_release);//槽留给下一轮的生产者
+                        return true;
+                  }
+            }else if(dif < 0){
+                  return false;//空的
+            }else{
+                  pos = head_.load(std::memory_order_relaxed);
+            }
+      }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::Readable_(){
+      size_t pos = head_.load(std::memory_order_relaxed);
+      return cells_[pos & mask_].seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::Writable_(){
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      return cells_[pos & mask_].seq.load(std::memory_order_acquire) == pos;
+}
+
+template<typename T>
+template<typename U>
+void LockFreeQueue<T>::Push_(U&& item){
+      int round = 0;
+      while(!isClose_.load(std::memory_order_relaxed)){
+            if(TryPush_(std::forward<U>(item))){
+                  //和消费者睡前的emptyWaiters_++、再看一眼队列配对：要么这里看到有人在睡，要么它看到新数据
+                  std::atomic_thread_fence(std::memory_order_seq_cst);
+                  if(emptyWaiters_.load(std::memory_order_relaxed) > 0){
+                        notEmpty_.fetch_add(1);
+                        Wake_(notEmpty_, 1);
+                  }
+                  return;
+            }
+            if(round < SPIN){
+                  Pause_();
+            }else if(round < SPIN + YIELDS){
+                  std::this_thread::yield();
+            }else{
+                  uint32_t word = notFull_.load();
+                  fullWaiters_.fetch_add(1);
+                  std::atomic_thread_fence(std::memory_order_seq_cst);
+                  if(!Writable_() && !isClose_.load()){
+                        Wait_(notFull_, word, -1);
+                  }
+                  fullWaiters_.fetch_sub(1);
+            }
+            round++;
+      }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::Pop_(T& item, int timeout){
+      std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+      int round = 0;
+      while(!isClose_.load(std::memory_order_relaxed)){
+            if(TryPop_(item)){
+                  std::atomic_thread_fence(std::memory_order_seq_cst);
+                  if(fullWaiters_.load(std::memory_order_relaxed) > 0){
+                        notFull_.fetch_add(1);
+                        Wake_(notFull_, 1);
+                  }
+                  return true;
+            }
+            if(round < SPIN){
+                  Pause_();
+            }else if(round < SPIN + YIELDS){
+                  std::this_thread::yield();
+            }else{
+                  int64_t waitNs = -1;
+                  if(timeout >= 0){
+                        waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       deadline - std::chrono::steady_clock::now()).count();
+                        if(waitNs <= 0){
+                              return false;//超时
+                        }
+                  }
+                  uint32_t word = notEmpty_.load();
+                  emptyWaiters_.fetch_add(1);
+                  std::atomic_thread_fence(std::memory_order_seq_cst);
+                  if(!Readable_() && !isClose_.load()){
+                        Wait_(notEmpty_, word, waitNs);
+                  }
+                  emptyWaiters_.fetch_sub(1);
+            }
+            round++;
+      }
+      return false;
+}
+
+template<typename T>
+void LockFreeQueue<T>::Pause_(){
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+}
+
+//word还等于expected才睡，被叫醒、超时、或者被信号打断都直接返回，由调用方重新检查
+template<typename T>
+void LockFreeQueue<T>::Wait_(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeoutNs){
+      struct timespec ts;
+      struct timespec* tsp = nullptr;
+      if(timeoutNs >= 0){
+            ts.tv_sec = timeoutNs / 1000000000;
+            ts.tv_nsec = timeoutNs % 1000000000;
+            tsp = &ts;
+      }
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, tsp, nullptr, 0);
+}
+
+template<typename T>
+void LockFreeQueue<T>::Wake_(std::atomic<uint32_t>& word, int count){
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+#endif
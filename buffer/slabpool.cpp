@@ -0,0 +1,101 @@
+#include "slabpool.h"
+#include <cstdlib>
+
+const size_t SlabPool::SLAB_SIZE;
+const size_t SlabPool::LOCAL_MAX;
+const size_t SlabPool::BATCH;
+const size_t SlabPool::GLOBAL_MAX;
+
+SlabPool* SlabPool::Instance(){
+    static SlabPool pool;
+    return &pool;
+}
+
+SlabPool::~SlabPool(){
+    std::lock_guard<std::mutex> locker(mtx_);
+    for(char* slab : global_)
+    {
+        free(slab);
+    }
+    global_.clear();
+}
+
+//线程本地缓存析构之后（线程退出、进程退出时其他静态对象析构）置位，之后的Alloc/Free直接走全局池
+static thread_local bool localGone = false;
+
+//线程本地缓存，thread_local保证每个线程一份，不需要加锁
+SlabPool::LocalCache& SlabPool::Local(){
+    static thread_local LocalCache cache;
+    return cache;
+}
+
+SlabPool::LocalCache::~LocalCache(){
+    SlabPool::Instance()->Drain(slabs, 0);
+    localGone = true;
+}
+
+char* SlabPool::Alloc(){
+    std::vector<char*> gone;
+    std::vector<char*>& local = localGone ? gone : Local().slabs;
+    if(local.empty())
+    {
+        Refill(local);
+    }
+    if(local.empty())//全局池也没有了，只能向系统申请
+    {
+        char* slab = static_cast<char*>(malloc(SLAB_SIZE));
+        assert(slab);
+        return slab;
+    }
+    char* slab = local.back();
+    local.pop_back();
+    if(localGone)//本地缓存已经没了，多取的块还回全局池
+    {
+        Drain(local, 0);
+    }
+    return slab;
+}
+
+void SlabPool::Free(char* slab){
+    assert(slab);
+    if(localGone)
+    {
+        std::vector<char*> one(1, slab);
+        Drain(one, 0);
+        return;
+    }
+    std::vector<char*>& local = Local().slabs;
+    local.push_back(slab);
+    if(local.size() > LOCAL_MAX)//本地缓存太多了，还一半给全局池，别的线程可以复用
+    {
+        Drain(local, LOCAL_MAX / 2);
+    }
+}
+
+size_t SlabPool::GlobalFreeSlabs(){
+    std::lock_guard<std::mutex> locker(mtx_);
+    return global_.size();
+}
+
+void SlabPool::Refill(std::vector<char*>& local){
+    std::lock_guard<std::mutex> locker(mtx_);
+    size_t n = global_.size() < BATCH ? global_.size() : BATCH;
+    local.insert(local.end(), global_.end() - n, global_.end());
+    global_.resize(global_.size() - n);
+}
+
+void SlabPool::Drain(std::vector<char*>& local, size_t keep){
+    std::lock_guard<std::mutex> locker(mtx_);
+    while(local.size() > keep)
+    {
+        if(global_.size() < GLOBAL_MAX)
+        {
+            global_.push_back(local.back());
+        }
+        else
+        {
+            free(local.back());//全局池已满，直接还给系统
+        }
+        local.pop_back();
+    }
+}
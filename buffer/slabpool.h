@@ -0,0 +1,43 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <assert.h>
+
+// 固定大小内存块(slab)池，供分段模式的Buffer使用
+// 每个线程先从自己的本地缓存取，本地缓存空了再从全局池批量补货，
+// 这样绝大部分Alloc/Free都不需要加锁，也不需要走malloc
+class SlabPool {
+public:
+       static const size_t SLAB_SIZE = 16 * 1024; // 每块16KB
+       static const size_t LOCAL_MAX = 64;        // 线程本地缓存最多保留的块数
+       static const size_t BATCH = 16;            // 本地与全局之间一次搬运的块数
+       static const size_t GLOBAL_MAX = 1024;     // 全局池最多保留的块数，多出来的直接释放
+
+       static SlabPool* Instance();
+
+       char* Alloc();          // 取一块SLAB_SIZE大小的内存
+       void Free(char* slab);  // 归还一块内存，可以在任意线程归还
+
+       size_t GlobalFreeSlabs(); // 全局池中空闲块数
+
+private:
+       SlabPool() = default;
+       ~SlabPool();
+
+       struct LocalCache {
+              std::vector<char*> slabs;
+              ~LocalCache(); // 线程退出时把缓存的块还给全局池
+       };
+       static LocalCache& Local();
+
+       void Refill(std::vector<char*>& local);  // 从全局池批量取块
+       void Drain(std::vector<char*>& local, size_t keep); // 批量还给全局池，只保留keep块
+
+       std::mutex mtx_;
+       std::vector<char*> global_; // 全局空闲块
+};
+
+#endif
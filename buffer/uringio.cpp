@@ -0,0 +1,459 @@
+#include "uringio.h"
+#include "buffer.h"
+#include "slabpool.h"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+const unsigned UringIO::RING_ENTRIES;
+const unsigned UringIO::BUF_ENTRIES;
+const uint16_t UringIO::BUF_GROUP;
+const uint64_t UringIO::SEND_TAG;
+const uint64_t UringIO::CANCEL_TAG;
+const uint64_t UringIO::TAG_MASK;
+const int UringIO::GEN_SHIFT;
+const long UringIO::WAIT_US;
+
+static int uring_setup(unsigned entries, struct io_uring_params* p){
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags){
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+//带超时等待完成事件（IORING_ENTER_EXT_ARG，5.11起；multishot recv要6.0，能走到这里的内核都支持）
+static int uring_wait(int fd, unsigned minComplete, struct __kernel_timespec* ts){
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(ts);
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, 0, minComplete,
+                                    IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)));
+}
+
+static int uring_register(int fd, unsigned opcode, void* arg, unsigned nrArgs){
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+UringIO* UringIO::Instance(){
+    static UringIO uring;
+    return &uring;
+}
+
+UringIO::UringIO()
+    : available_(false), ringFd_(-1), sqPtr_(MAP_FAILED), cqPtr_(MAP_FAILED), sqSize_(0), cqSize_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqesSize_(0),
+      sqHead_(nullptr), sqTail_(nullptr), sqMask_(nullptr), sqArray_(nullptr),
+      cqHead_(nullptr), cqTail_(nullptr), cqMask_(nullptr), cqes_(nullptr), toSubmit_(0),
+      bufRing_(nullptr), bufTail_(0), nextGen_(0) {
+    available_ = Setup() && Probe() && ProbeMultishot();
+    if(!available_)//内核不支持，Buffer继续走readv/write
+    {
+        Teardown();
+    }
+}
+
+UringIO::~UringIO(){
+    Teardown();
+}
+
+bool UringIO::Setup(){
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd_ = uring_setup(RING_ENTRIES, &params);
+    if(ringFd_ < 0)//内核太老、被seccomp禁用等情况
+    {
+        return false;
+    }
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        return false;
+    }
+    sqSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(cqSize_ > sqSize_)
+    {
+        sqSize_ = cqSize_;
+    }
+    sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if(sqPtr_ == MAP_FAILED)
+    {
+        return false;
+    }
+    cqPtr_ = sqPtr_;//单次mmap，SQ和CQ共用一块
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(
+        mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if(sqes_ == MAP_FAILED)
+    {
+        return false;
+    }
+    char* sq = static_cast<char*>(sqPtr_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqPtr_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    //注册缓冲环，每一项都是一块slab
+    void* ringMem = nullptr;
+    if(posix_memalign(&ringMem, 4096, BUF_ENTRIES * sizeof(struct io_uring_buf)) != 0)
+    {
+        return false;
+    }
+    memset(ringMem, 0, BUF_ENTRIES * sizeof(struct io_uring_buf));
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(ringMem);
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ringMem);
+    reg.ring_entries = BUF_ENTRIES;
+    reg.bgid = BUF_GROUP;
+    if(uring_register(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)//5.19以前的内核不支持
+    {
+        return false;
+    }
+    bufs_.assign(BUF_ENTRIES, nullptr);
+    for(uint16_t bid = 0; bid < BUF_ENTRIES; bid++)
+    {
+        bufs_[bid] = SlabPool::Instance()->Alloc();
+        ProvideBuf(bid);
+    }
+    return true;
+}
+
+bool UringIO::Probe(){
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    std::vector<char> mem(len, 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(mem.data());
+    if(uring_register(ringFd_, IORING_REGISTER_PROBE, probe, 256) < 0)
+    {
+        return false;
+    }
+    const int ops[] = {IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL};
+    for(int op : ops)
+    {
+        if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//multishot recv是6.0才有的，没法用probe查，只能实际跑一次
+bool UringIO::ProbeMultishot(){
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0)
+    {
+        return false;
+    }
+    Buffer buffer;
+    int err = 0;
+    bool ok = write(sv[1], "x", 1) == 1;
+    available_ = true;//Recv内部依赖这个标志
+    ok = ok && Recv(sv[0], buffer, &err) == 1;
+    ok = ok && armed_.count(sv[0]);//没有IORING_CQE_F_MORE说明内核把它当普通recv处理了
+    Forget(sv[0]);
+    available_ = false;
+    close(sv[0]);
+    close(sv[1]);
+    return ok;
+}
+
+void UringIO::Teardown(){
+    if(sqes_ != MAP_FAILED)
+    {
+        munmap(sqes_, sqesSize_);
+        sqes_ = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    }
+    if(sqPtr_ != MAP_FAILED)
+    {
+        munmap(sqPtr_, sqSize_);
+        sqPtr_ = cqPtr_ = MAP_FAILED;
+    }
+    if(ringFd_ >= 0)
+    {
+        close(ringFd_);//关闭环之后内核才会放开缓冲环，之后才能释放slab
+        ringFd_ = -1;
+    }
+    for(char* slab : bufs_)
+    {
+        if(slab)
+        {
+            SlabPool::Instance()->Free(slab);
+        }
+    }
+    bufs_.clear();
+    free(bufRing_);
+    bufRing_ = nullptr;
+}
+
+struct io_uring_sqe* UringIO::GetSqe(){
+    unsigned tail = *sqTail_;
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(tail - head >= RING_ENTRIES)//提交队列满了，先提交出去
+    {
+        Enter(0);
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if(tail - head >= RING_ENTRIES)
+        {
+            return nullptr;
+        }
+    }
+    unsigned idx = tail & *sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    toSubmit_++;
+    return sqe;
+}
+
+//提交并顺带运行内核里挂起的task work，这样已经到达的数据才会出现在CQ里
+int UringIO::Enter(unsigned minComplete){
+    int ret = uring_enter(ringFd_, toSubmit_, minComplete, IORING_ENTER_GETEVENTS);
+    if(ret >= 0)
+    {
+        toSubmit_ -= static_cast<unsigned>(ret) < toSubmit_ ? ret : toSubmit_;
+    }
+    return ret;
+}
+
+//CQ里没有东西时才真正睡；别的线程可能在这期间把我们要的事件收走，所以不能无限等
+void UringIO::WaitCqe(){
+    struct __kernel_timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = WAIT_US * 1000;
+    uring_wait(ringFd_, 1, &ts);
+}
+
+//收割CQ，按fd分拣到各自的暂存队列，调用者再取自己那一份
+void UringIO::Reap(){
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    while(head != tail)
+    {
+        const struct io_uring_cqe& cqe = cqes_[head & *cqMask_];
+        int fd = static_cast<int>(cqe.user_data & 0xffffffffULL);
+        uint64_t tag = cqe.user_data & TAG_MASK;
+        if(tag == SEND_TAG)
+        {
+            sendRes_[fd] = cqe.res;
+        }
+        else if(tag == 0)
+        {
+            Completion c = {cqe.res, cqe.flags};
+            uint32_t gen = static_cast<uint32_t>(cqe.user_data >> GEN_SHIFT);
+            std::unordered_map<int, uint32_t>::iterator it = armed_.find(fd);
+            bool current = it != armed_.end() && it->second == gen;
+            if(current)
+            {
+                pending_[fd].push_back(c);
+            }
+            else if(c.flags & IORING_CQE_F_BUFFER)//fd已经被Forget了，或者是复用这个号码之前的旧连接，缓冲区直接还给环
+            {
+                ProvideBuf(static_cast<uint16_t>(c.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+            if(current && !(c.flags & IORING_CQE_F_MORE))//multishot结束了（出错、缓冲区耗尽或对端关闭），下次重新挂
+            {
+                armed_.erase(it);
+            }
+        }
+        head++;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void UringIO::ArmRecv(int fd){
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = BUF_GROUP;
+    uint32_t gen = nextGen_++ & ((1U << (64 - GEN_SHIFT)) - 1);
+    sqe->user_data = (static_cast<uint64_t>(gen) << GEN_SHIFT) | static_cast<uint32_t>(fd);
+    armed_[fd] = gen;
+}
+
+void UringIO::ProvideBuf(uint16_t bid){
+    //C++里内核头文件的柔性数组会多出一个空结构体的偏移，这里按C的布局直接当数组用
+    struct io_uring_buf* ring = reinterpret_cast<struct io_uring_buf*>(bufRing_);
+    struct io_uring_buf* buf = &ring[bufTail_ & (BUF_ENTRIES - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(bufs_[bid]);
+    buf->len = SlabPool::SLAB_SIZE;
+    buf->bid = bid;
+    bufTail_++;
+    __atomic_store_n(&ring[0].resv, bufTail_, __ATOMIC_RELEASE);//环尾和第0项的resv字段重叠
+}
+
+//语义与非阻塞readv一致：返回读到的字节数，0表示对端关闭，-1时Errno给出原因（没有数据时为EAGAIN）
+ssize_t UringIO::Recv(int fd, Buffer& buffer, int* Errno){
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(!armed_.count(fd))
+    {
+        ArmRecv(fd);
+    }
+    if(toSubmit_ > 0)//只有真有SQE要交时才进内核
+    {
+        Enter(0);
+    }
+    Reap();
+    std::deque<Completion>& queue = pending_[fd];
+    if(queue.empty())//没有现成的数据：进一次内核跑掉本线程挂起的task work，刚到的数据才会出现在CQ里
+    {
+        Enter(0);
+        Reap();
+    }
+
+    ssize_t total = 0;
+    while(!queue.empty())
+    {
+        Completion c = queue.front();
+        if(c.res <= 0 && c.res != -ENOBUFS && total > 0)//先把已经读到的数据交出去，EOF/错误留给下一次
+        {
+            break;
+        }
+        queue.pop_front();
+        if(c.res > 0)
+        {
+            uint16_t bid = static_cast<uint16_t>(c.flags >> IORING_CQE_BUFFER_SHIFT);
+            if(buffer.IsChained())//分段Buffer直接接管这块slab，环里补一块新的
+            {
+                buffer.AdoptSlab(bufs_[bid], static_cast<size_t>(c.res));
+                bufs_[bid] = SlabPool::Instance()->Alloc();
+            }
+            else
+            {
+                buffer.Append(bufs_[bid], static_cast<size_t>(c.res));
+            }
+            ProvideBuf(bid);
+            total += c.res;
+        }
+        else if(c.res == 0)//结束的完成事件在Reap里已经把fd从armed_去掉了，这里不能再删，可能已经挂上了新的
+        {
+            return 0;
+        }
+        else if(c.res == -ENOBUFS)//缓冲环暂时被用光，数据还在socket里，上面已经还回了缓冲区，马上重新挂上
+        {
+            if(!armed_.count(fd))
+            {
+                ArmRecv(fd);
+                Enter(0);
+            }
+        }
+        else
+        {
+            *Errno = -c.res;
+            return -1;
+        }
+    }
+    if(total == 0)
+    {
+        *Errno = EAGAIN;
+        return -1;
+    }
+    return total;
+}
+
+ssize_t UringIO::Send(int fd, const struct iovec* iov, int iovcnt, int* Errno){
+    std::unique_lock<std::mutex> locker(mtx_);
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iovcnt;
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+    {
+        *Errno = EAGAIN;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;//不让内核在EAGAIN时挂起重试，保持非阻塞write的语义
+    sqe->user_data = SEND_TAG | static_cast<uint32_t>(fd);
+    unsigned pos = *sqTail_ - 1;//这个SQE在提交队列里的位置
+    //MSG_DONTWAIT的sendmsg在提交时就地完成，一般提交完就能收到结果；万一没有，放开锁再等，不挡住别的连接
+    //msg和iov都在调用者的栈上，内核一旦拿走这个SQE就必须等到它的完成事件才能返回
+    while(true)
+    {
+        if(toSubmit_ > 0 && Enter(0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            int err = errno;
+            unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            if(static_cast<int>(pos - head) >= 0)//内核还没拿走：改成不带指针的NOP，以后谁提交都无害，结果也不会记到这个fd上
+            {
+                struct io_uring_sqe* stale = &sqes_[pos & *sqMask_];
+                memset(stale, 0, sizeof(*stale));
+                stale->opcode = IORING_OP_NOP;
+                stale->user_data = CANCEL_TAG | static_cast<uint32_t>(fd);
+                *Errno = err;
+                return -1;
+            }
+        }
+        Reap();
+        if(sendRes_.count(fd))
+        {
+            break;
+        }
+        locker.unlock();
+        WaitCqe();
+        locker.lock();
+    }
+    int res = sendRes_[fd];
+    sendRes_.erase(fd);
+    if(res < 0)
+    {
+        *Errno = -res;
+        return -1;
+    }
+    return res;
+}
+
+void UringIO::Forget(int fd){
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(!available_)
+    {
+        return;
+    }
+    if(armed_.count(fd))//按fd取消，必须在close(fd)之前提交，关掉以后内核就找不到这个文件了
+    {
+        struct io_uring_sqe* sqe = GetSqe();
+        if(sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD;
+            sqe->user_data = CANCEL_TAG | static_cast<uint32_t>(fd);
+        }
+        armed_.erase(fd);
+        Enter(0);
+    }
+    std::unordered_map<int, std::deque<Completion>>::iterator it = pending_.find(fd);
+    if(it != pending_.end())//没取走的数据所在的缓冲区还给环
+    {
+        for(const Completion& c : it->second)
+        {
+            if(c.res > 0 && (c.flags & IORING_CQE_F_BUFFER))
+            {
+                ProvideBuf(static_cast<uint16_t>(c.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        }
+        pending_.erase(it);
+    }
+    sendRes_.erase(fd);//旧连接留下的send结果不能交给复用这个号码的新连接
+}
@@ -0,0 +1,93 @@
+#ifndef URINGIO_H
+#define URINGIO_H
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+class Buffer;
+
+// Buffer::ReadFd/WriteFd的io_uring后端，直接用系统调用，不依赖liburing
+// 读：每个fd挂一个multishot recv，数据由内核直接写进注册好的缓冲环(provided buffer ring)，
+//     环里的每块都是SlabPool的slab，分段模式的Buffer直接接管这块内存，不再拷贝
+// 写：sendmsg + MSG_DONTWAIT，语义和非阻塞write一致
+// 整个进程共用一个环，用互斥锁保护提交和收割，保证同一个fd的数据不会分散到多个环里乱序；
+// 锁里只做不阻塞的事：数据已经在CQ里时Recv不进内核，Send等结果时先放开锁
+// 连接关闭时必须在close(fd)之前调Forget（Buffer::ForgetFd），否则multishot recv和它占着的缓冲区一直留在环里
+class UringIO {
+public:
+       static UringIO* Instance();
+
+       bool Available() const { return available_; } // 内核是否支持（运行时探测）
+
+       ssize_t Recv(int fd, Buffer& buffer, int* Errno);
+       ssize_t Send(int fd, const struct iovec* iov, int iovcnt, int* Errno);
+       void Forget(int fd); // 连接关闭、close(fd)之前调用，取消该fd上的multishot recv，丢掉没取走的数据
+
+private:
+       UringIO();
+       ~UringIO();
+
+       bool Setup();
+       bool Probe();             // 检查内核是否支持需要的操作码
+       bool ProbeMultishot();    // 用socketpair实际跑一次multishot recv
+       void Teardown();
+
+       struct io_uring_sqe* GetSqe();
+       int Enter(unsigned minComplete);
+       void WaitCqe();   // 不持锁等CQ里出现新的完成事件，最多等WAIT_US
+       void Reap();
+       void ArmRecv(int fd);
+       void ProvideBuf(uint16_t bid);
+
+       static const unsigned RING_ENTRIES = 256;
+       static const unsigned BUF_ENTRIES = 128; // 必须是2的幂
+       static const uint16_t BUF_GROUP = 0;
+       // user_data：低32位是fd，32~33位区分操作类型，recv的34位以上是挂上它时的代号
+       // fd关掉后号码会被新连接复用，代号对不上的完成事件属于旧连接，直接丢掉
+       static const uint64_t SEND_TAG = 1ULL << 32;
+       static const uint64_t CANCEL_TAG = 2ULL << 32;
+       static const uint64_t TAG_MASK = 3ULL << 32;
+       static const int GEN_SHIFT = 34;
+       static const long WAIT_US = 1000;
+
+       struct Completion {
+              int res;
+              uint32_t flags;
+       };
+
+       bool available_;
+       int ringFd_;
+       void* sqPtr_;
+       void* cqPtr_;
+       size_t sqSize_;
+       size_t cqSize_;
+       struct io_uring_sqe* sqes_;
+       size_t sqesSize_;
+       unsigned* sqHead_;
+       unsigned* sqTail_;
+       unsigned* sqMask_;
+       unsigned* sqArray_;
+       unsigned* cqHead_;
+       unsigned* cqTail_;
+       unsigned* cqMask_;
+       struct io_uring_cqe* cqes_;
+       unsigned toSubmit_;
+
+       struct io_uring_buf_ring* bufRing_;
+       std::vector<char*> bufs_; // bid -> slab
+       uint16_t bufTail_;
+
+       std::unordered_map<int, std::deque<Completion>> pending_; // 按fd暂存的recv完成事件
+       std::unordered_map<int, uint32_t> armed_;                  // 已经挂上multishot recv的fd -> 代号
+       uint32_t nextGen_;
+       std::unordered_map<int, int> sendRes_;                     // 按fd暂存的send结果
+       std::mutex mtx_;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <ctype.h>
+#include "../buffer/slabpool.h"
+
+const size_t Arena::BLOCK_SIZE = SlabPool::SLAB_SIZE;
+
+Arena::~Arena(){
+    Release();
+}
+
+void* Arena::AllocSlow_(size_t size, size_t align){
+    if(size + align > BLOCK_SIZE)//一块放不下，单独申请
+    {
+        void* p = nullptr;
+        if(posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size ? size : 1) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        large_.push_back(static_cast<char*>(p));
+        used_ += size;
+        return p;
+    }
+    //换到下一块：先用Reset之后留下的，没有了再从SlabPool取
+    if(ptr_)
+    {
+        cur_++;
+    }
+    if(cur_ == blocks_.size())
+    {
+        blocks_.push_back(SlabPool::Instance()->Alloc());
+    }
+    char* block = blocks_[cur_];
+    ptr_ = block;
+    end_ = block + BLOCK_SIZE;
+    return Alloc(size, align);
+}
+
+StrView Arena::CopyLower(const char* data, size_t len){
+    char* p = static_cast<char*>(Alloc(len, 1));
+    for(size_t i = 0; i < len; i++)
+    {
+        p[i] = static_cast<char>(tolower(static_cast<unsigned char>(data[i])));
+    }
+    return StrView(p, len);
+}
+
+void Arena::Reset(){
+    if(used_ > highWater_)
+    {
+        highWater_ = used_;
+    }
+    for(char* p : large_)
+    {
+        free(p);
+    }
+    large_.clear();
+    cur_ = 0;
+    ptr_ = blocks_.empty() ? nullptr : blocks_[0];
+    end_ = ptr_ ? ptr_ + BLOCK_SIZE : nullptr;
+    used_ = 0;
+}
+
+void Arena::Release(){
+    Reset();
+    for(char* block : blocks_)
+    {
+        SlabPool::Instance()->Free(block);
+    }
+    blocks_.clear();
+    ptr_ = end_ = nullptr;
+}
@@ -0,0 +1,100 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include "strview.h"
+
+// 按请求复用的bump分配器：内存从SlabPool取整块，分配只是移动指针，不能单独释放
+// Reset()把指针拨回第一块，已经取到的块都留着给下一个请求用，keep-alive连接上稳定之后不再走malloc
+// 超过一块大小的分配单独申请，Reset()时释放（正常请求的字段都比一块小）
+class Arena {
+public:
+    static const size_t BLOCK_SIZE;//等于SlabPool::SLAB_SIZE
+
+    Arena() : cur_(0), ptr_(nullptr), end_(nullptr), used_(0), highWater_(0) {}
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+        char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(ptr_) + align - 1) & ~(align - 1));
+        if(ptr_ && p + size <= end_)
+        {
+            used_ += p + size - ptr_;
+            ptr_ = p + size;
+            return p;
+        }
+        return AllocSlow_(size, align);
+    }
+
+    template<typename T>
+    T* AllocArray(size_t n) {
+        return static_cast<T*>(Alloc(sizeof(T) * n, alignof(T)));
+    }
+
+    StrView Copy(const char* data, size_t len) {
+        char* p = static_cast<char*>(Alloc(len, 1));
+        memcpy(p, data, len);
+        return StrView(p, len);
+    }
+    StrView CopyLower(const char* data, size_t len);//复制并转成小写，用于字段名
+
+    void Reset();//O(1)回到起点（有超大分配时额外释放它们）
+    void Release();//把块都还给SlabPool
+
+    size_t Used() const { return used_; }//当前请求用掉的字节数（含对齐）
+    size_t HighWater() const { return highWater_ > used_ ? highWater_ : used_; }//历史最大用量
+    size_t Blocks() const { return blocks_.size(); }
+
+private:
+    void* AllocSlow_(size_t size, size_t align);
+
+    std::vector<char*> blocks_;//从SlabPool取到的块，Reset后复用
+    std::vector<char*> large_;//超大分配
+    size_t cur_;//当前在用的块
+    char* ptr_;
+    char* end_;
+    size_t used_;
+    size_t highWater_;
+};
+
+// 在Arena里分配的定长元素数组，满了翻倍换一块新的（旧的随Arena一起回收），只能放平凡类型
+template<typename T>
+class ArenaList {
+public:
+    ArenaList() : data_(nullptr), size_(0), cap_(0) {}
+
+    void Clear() { data_ = nullptr; size_ = cap_ = 0; }//Arena Reset之前调用
+
+    void Push(Arena& arena, const T& item) {
+        if(size_ == cap_)
+        {
+            size_t cap = cap_ ? cap_ * 2 : 16;
+            T* data = arena.AllocArray<T>(cap);
+            if(size_ > 0)
+            {
+                memcpy(data, data_, sizeof(T) * size_);
+            }
+            data_ = data;
+            cap_ = cap;
+        }
+        data_[size_++] = item;
+    }
+
+    size_t Size() const { return size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+private:
+    T* data_;
+    size_t size_;
+    size_t cap_;
+};
+
+#endif
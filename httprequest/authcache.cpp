@@ -0,0 +1,188 @@
+#include "authcache.h"
+#include <cstring>
+#include <random>
+#include <functional>
+
+template<typename Gen>
+static void FillBytes(Gen& gen, uint8_t* out, size_t len){
+    for(size_t i = 0; i < len; i += 4)
+    {
+        uint32_t r = static_cast<uint32_t>(gen());
+        for(size_t j = 0; j < 4 && i + j < len; j++)
+        {
+            out[i + j] = static_cast<uint8_t>(r >> (j * 8));
+        }
+    }
+}
+
+AuthCache::AuthCache() : shardCapacity_(4096), ttl_(std::chrono::seconds(300)) {
+    for(Shard& shard : shards_)
+    {
+        shard.hits.store(0, std::memory_order_relaxed);
+        shard.misses.store(0, std::memory_order_relaxed);
+    }
+    std::random_device rd;//进程密钥只生成一次，直接取系统随机数
+    FillBytes(rd, secret_, sizeof(secret_));
+}
+
+AuthCache* AuthCache::Instance(){
+    static AuthCache cache;
+    return &cache;
+}
+
+void AuthCache::Init(size_t capacity, int ttlSec){
+    Clear();
+    for(Shard& shard : shards_)
+    {
+        shard.hits.store(0, std::memory_order_relaxed);
+        shard.misses.store(0, std::memory_order_relaxed);
+    }
+    shardCapacity_ = (capacity + SHARDS - 1) / SHARDS;
+    ttl_ = std::chrono::seconds(ttlSec);
+}
+
+AuthCache::Shard& AuthCache::ShardOf(const std::string& user){
+    return shards_[std::hash<std::string>()(user) % SHARDS];
+}
+
+//每个线程一个引擎，第一次用时从random_device取一次种子，之后Insert不再打开random_device
+//盐只需要各不相同，摘要的不可预测靠secret_
+void AuthCache::Random_(uint8_t* out, size_t len){
+    static thread_local std::mt19937 engine = SeedEngine_();
+    FillBytes(engine, out, len);
+}
+
+std::mt19937 AuthCache::SeedEngine_(){
+    std::random_device rd;
+    std::seed_seq seq{rd(), rd(), rd(), rd(), rd(), rd(), rd(), rd()};
+    return std::mt19937(seq);
+}
+
+//摘要 = SHA-256(盐 | 进程密钥 | 用户名 | 0 | 密码)
+void AuthCache::Digest_(const uint8_t salt[SALT_SIZE], const std::string& user, const std::string& passwd,
+                        uint8_t out[Sha256::DIGEST_SIZE]) const{
+    Sha256 sha;
+    sha.Update(salt, SALT_SIZE);
+    sha.Update(secret_, sizeof(secret_));
+    sha.Update(user.data(), user.size());
+    uint8_t sep = 0;
+    sha.Update(&sep, 1);
+    sha.Update(passwd.data(), passwd.size());
+    sha.Final(out);
+}
+
+bool AuthCache::Verify(const std::string& user, const std::string& passwd){
+    Shard& shard = ShardOf(user);
+    uint8_t salt[SALT_SIZE];
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        auto it = shard.index.find(user);
+        if(it == shard.index.end())
+        {
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if(Clock::now() >= it->second->expire)//过期了，顺手删掉
+        {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        memcpy(salt, it->second->salt, SALT_SIZE);
+        memcpy(digest, it->second->digest, sizeof(digest));
+    }
+    //算摘要不需要持锁
+    uint8_t actual[Sha256::DIGEST_SIZE];
+    Digest_(salt, user, passwd, actual);
+    uint8_t diff = 0;//逐字节比较完，耗时和密码对错无关
+    for(size_t i = 0; i < sizeof(actual); i++)
+    {
+        diff |= actual[i] ^ digest[i];
+    }
+    if(diff == 0)//计数是原子的，不用为了它再加一次锁
+    {
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AuthCache::Insert(const std::string& user, const std::string& passwd){
+    if(shardCapacity_ == 0)
+    {
+        return;
+    }
+    Entry entry;
+    entry.user = user;
+    Random_(entry.salt, SALT_SIZE);
+    Digest_(entry.salt, user, passwd, entry.digest);
+    entry.expire = Clock::now() + ttl_;
+
+    Shard& shard = ShardOf(user);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(user);
+    if(it != shard.index.end())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    while(shard.lru.size() >= shardCapacity_)//淘汰最久没用的
+    {
+        shard.index.erase(shard.lru.back().user);
+        shard.lru.pop_back();
+    }
+    shard.lru.push_front(std::move(entry));
+    shard.index[user] = shard.lru.begin();
+}
+
+void AuthCache::Invalidate(const std::string& user){
+    Shard& shard = ShardOf(user);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(user);
+    if(it != shard.index.end())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+void AuthCache::Clear(){
+    for(Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        shard.lru.clear();
+        shard.index.clear();
+    }
+}
+
+uint64_t AuthCache::Hits(){
+    uint64_t total = 0;
+    for(Shard& shard : shards_)
+    {
+        total += shard.hits.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t AuthCache::Misses(){
+    uint64_t total = 0;
+    for(Shard& shard : shards_)
+    {
+        total += shard.misses.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t AuthCache::Size(){
+    size_t total = 0;
+    for(Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        total += shard.lru.size();
+    }
+    return total;
+}
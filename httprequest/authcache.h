@@ -0,0 +1,68 @@
+#ifndef AUTHCACHE_H
+#define AUTHCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdint.h>
+#include "sha256.h"
+
+// 登录验证结果缓存，放在UserVerify访问数据库之前
+// 只缓存验证通过的用户名和密码，密码存成加盐的SHA-256，不保存明文；每条记录有自己的随机盐，外加进程级的密钥
+// 按用户名哈希分成SHARDS个分片，各自一把锁、一条LRU链表，超过TTL的记录视为不存在
+// 注册时使对应用户名失效；密码错误不缓存，仍然交给数据库判断
+class AuthCache {
+public:
+    static const size_t SHARDS = 16;
+    static const size_t SALT_SIZE = 16;
+
+    static AuthCache* Instance();
+
+    void Init(size_t capacity, int ttlSec);//总容量为0时关闭缓存
+    bool Verify(const std::string& user, const std::string& passwd);//命中且密码一致返回true
+    void Insert(const std::string& user, const std::string& passwd);//数据库验证通过之后调用
+    void Invalidate(const std::string& user);
+    void Clear();
+
+    uint64_t Hits();
+    uint64_t Misses();
+    size_t Size();
+
+private:
+    AuthCache();
+    ~AuthCache() = default;
+
+    typedef std::chrono::steady_clock Clock;
+    struct Entry {
+        std::string user;
+        uint8_t salt[SALT_SIZE];
+        uint8_t digest[Sha256::DIGEST_SIZE];
+        Clock::time_point expire;
+    };
+    typedef std::list<Entry> EntryList;
+
+    struct alignas(64) Shard {//分片之间不共享缓存行
+        std::mutex mtx;
+        EntryList lru;//表头是最近用过的
+        std::unordered_map<std::string, EntryList::iterator> index;
+        std::atomic<uint64_t> hits;//命中路径上不为计数再加锁，relaxed即可
+        std::atomic<uint64_t> misses;
+    };
+
+    Shard& ShardOf(const std::string& user);
+    void Digest_(const uint8_t salt[SALT_SIZE], const std::string& user, const std::string& passwd,
+                 uint8_t out[Sha256::DIGEST_SIZE]) const;
+    static void Random_(uint8_t* out, size_t len);//填盐，用本线程的引擎
+    static std::mt19937 SeedEngine_();
+
+    Shard shards_[SHARDS];
+    size_t shardCapacity_;
+    Clock::duration ttl_;
+    uint8_t secret_[32];//进程启动时随机生成，缓存里的摘要离开本进程没有用处
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "bodysink.h"
+#include <errno.h>
+#include <stdlib.h>
+
+bool MemoryBodySink::Write(const char* data, size_t len){
+    if(len > cap_ - data_.size())
+    {
+        return false;
+    }
+    data_.append(data, len);
+    return true;
+}
+
+bool FileBodySink::Open_(){
+    std::string path = dir_ + "/tinyweb-body-XXXXXX";
+    fd_ = mkstemp(&path[0]);
+    if(fd_ < 0)
+    {
+        return false;
+    }
+    unlink(path.c_str());//只用fd访问，进程退出或者关闭后文件自动回收
+    return true;
+}
+
+bool FileBodySink::Write(const char* data, size_t len){
+    if(fd_ < 0 && !Open_())
+    {
+        return false;
+    }
+    while(len > 0)
+    {
+        ssize_t n = write(fd_, data, len);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+        size_ += n;
+    }
+    return true;
+}
+
+bool FileBodySink::Finish(){
+    if(fd_ < 0 && !Open_())//空请求体也给一个可读的fd
+    {
+        return false;
+    }
+    return lseek(fd_, 0, SEEK_SET) == 0;
+}
+
+void FileBodySink::Reset(){
+    if(fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+int FileBodySink::ReleaseFd(){
+    int fd = fd_;
+    fd_ = -1;
+    size_ = 0;
+    return fd;
+}
+
+static int HexValue(char ch){
+    if(ch >= '0' && ch <= '9')
+    {
+        return ch - '0';
+    }
+    if(ch >= 'a' && ch <= 'f')
+    {
+        return ch - 'a' + 10;
+    }
+    if(ch >= 'A' && ch <= 'F')
+    {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+void UrlencodedBodySink::Reset(){
+    size_ = 0;
+    fields_ = 0;
+    tooLarge_ = false;
+    inValue_ = false;
+    hexLeft_ = 0;
+    hexValue_ = 0;
+    key_.clear();
+    value_.clear();
+}
+
+bool UrlencodedBodySink::Put_(char ch){
+    std::string& field = inValue_ ? value_ : key_;
+    if(field.size() >= maxField_)
+    {
+        tooLarge_ = true;
+        return false;
+    }
+    field.push_back(ch);
+    return true;
+}
+
+bool UrlencodedBodySink::Emit_(){
+    if(!key_.empty() && out_)
+    {
+        if(fields_ >= maxFields_)
+        {
+            tooLarge_ = true;
+            return false;
+        }
+        fields_++;
+        out_(key_, value_);
+    }
+    key_.clear();
+    value_.clear();
+    inValue_ = false;
+    return true;
+}
+
+bool UrlencodedBodySink::Write(const char* data, size_t len){
+    if(len > maxTotal_ - size_)//解码出的字段都放在内存里，总量要有上限
+    {
+        tooLarge_ = true;
+        return false;
+    }
+    size_ += len;
+    for(const char* p = data; p < data + len; p++)
+    {
+        char ch = *p;
+        if(hexLeft_ > 0)//正在解析%XX
+        {
+            int v = HexValue(ch);
+            if(v >= 0)
+            {
+                hexRaw_[2 - hexLeft_] = ch;
+                hexValue_ = hexValue_ * 16 + v;
+                if(--hexLeft_ == 0 && !Put_(static_cast<char>(hexValue_)))
+                {
+                    return false;
+                }
+                continue;
+            }
+            //不是合法的转义，'%'和已经读到的字符原样保留，当前字符按普通字符继续处理
+            if(!Put_('%') || (hexLeft_ == 1 && !Put_(hexRaw_[0])))
+            {
+                return false;
+            }
+            hexLeft_ = 0;
+        }
+        if(ch == '&')
+        {
+            if(!Emit_())
+            {
+                return false;
+            }
+        }
+        else if(ch == '=' && !inValue_)
+        {
+            inValue_ = true;
+        }
+        else if(ch == '%')
+        {
+            hexLeft_ = 2;
+            hexValue_ = 0;
+        }
+        else if(!Put_(ch == '+' ? ' ' : ch))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UrlencodedBodySink::Finish(){
+    if(hexLeft_ > 0)//结尾的转义不完整，原样保留
+    {
+        if(!Put_('%') || (hexLeft_ == 1 && !Put_(hexRaw_[0])))
+        {
+            return false;
+        }
+        hexLeft_ = 0;
+    }
+    return Emit_();
+}
@@ -0,0 +1,99 @@
+#ifndef BODYSINK_H
+#define BODYSINK_H
+
+#include <string>
+#include <functional>
+#include <unistd.h>
+#include <fcntl.h>
+
+// 请求体的去处：HttpRequest边收边把解码后的请求体交给sink，不需要整个请求体都留在内存里
+// Content-Length和chunked两种方式收到的数据都走同一个接口
+class BodySink {
+public:
+    virtual ~BodySink() {}
+    virtual bool Write(const char* data, size_t len) = 0;//返回false表示放不下或者出错，请求按失败处理
+    virtual bool Finish() { return true; }//请求体收完
+    virtual void Reset() = 0;//开始下一个请求
+    virtual size_t Size() const = 0;//已经写入的字节数
+};
+
+// 放在内存里，超过上限就拒绝
+class MemoryBodySink : public BodySink {
+public:
+    explicit MemoryBodySink(size_t cap = 1024 * 1024) : cap_(cap) {}
+
+    bool Write(const char* data, size_t len) override;
+    void Reset() override { data_.clear(); }
+    size_t Size() const override { return data_.size(); }
+
+    void SetCap(size_t cap) { cap_ = cap; }
+    size_t Cap() const { return cap_; }
+    const std::string& Data() const { return data_; }
+
+private:
+    size_t cap_;
+    std::string data_;
+};
+
+// 写进临时文件，用于大文件上传；文件创建后立刻unlink，fd关掉后自动删除
+class FileBodySink : public BodySink {
+public:
+    explicit FileBodySink(const char* dir = "/tmp") : dir_(dir), fd_(-1), size_(0) {}
+    ~FileBodySink() override { Reset(); }
+    FileBodySink(const FileBodySink&) = delete;
+    FileBodySink& operator=(const FileBodySink&) = delete;
+
+    bool Write(const char* data, size_t len) override;
+    bool Finish() override;
+    void Reset() override;
+    size_t Size() const override { return size_; }
+
+    int Fd() const { return fd_; }//收完之后可以从头pread/sendfile
+    int ReleaseFd();//把fd交给调用者，sink不再负责关闭
+
+private:
+    bool Open_();
+
+    std::string dir_;
+    int fd_;
+    size_t size_;
+};
+
+// application/x-www-form-urlencoded增量解码：key=value&key=value，'+'是空格，%XX是转义字符
+// 数据可以从任意位置切开分多次写入，转义序列跨两次Write也能正确解码
+class UrlencodedBodySink : public BodySink {
+public:
+    typedef std::function<void(const std::string& key, const std::string& value)> FieldHandler;//每解码出一个字段调用一次
+
+    //maxTotal限制整个请求体的字节数，maxFields限制字段个数，超过时Write/Finish返回false，TooLarge()为true
+    explicit UrlencodedBodySink(const FieldHandler& out = FieldHandler(), size_t maxField = 64 * 1024,
+                                size_t maxTotal = 1024 * 1024, size_t maxFields = 1024)
+        : out_(out), maxField_(maxField), maxTotal_(maxTotal), maxFields_(maxFields) { Reset(); }
+
+    void SetOutput(const FieldHandler& out) { out_ = out; }
+    void SetLimits(size_t maxTotal, size_t maxFields) { maxTotal_ = maxTotal; maxFields_ = maxFields; }
+    bool TooLarge() const { return tooLarge_; }
+    bool Write(const char* data, size_t len) override;
+    bool Finish() override;
+    void Reset() override;
+    size_t Size() const override { return size_; }
+
+private:
+    bool Put_(char ch);//解码后的一个字符
+    bool Emit_();//一个字段结束，字段数超过上限时返回false
+
+    FieldHandler out_;
+    size_t maxField_;//单个key或value的长度上限
+    size_t maxTotal_;
+    size_t maxFields_;
+    size_t size_;
+    size_t fields_;//已经交出去的字段数
+    bool tooLarge_;
+    bool inValue_;//当前在'='后面
+    int hexLeft_;//'%'后面还差几个十六进制字符，0表示不在转义中
+    int hexValue_;
+    char hexRaw_[2];//转义不完整时原样输出
+    std::string key_, value_;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef HEADERTABLE_H
+#define HEADERTABLE_H
+
+#include <vector>
+#include <stdint.h>
+#include "strview.h"
+
+// 零拷贝解析用的请求头表：字段名和值都记成相对Buffer首地址的偏移(Span)，不复制内容
+// 前INLINE_SIZE个字段放在对象内的定长数组里，正常请求不会申请内存；超出的部分才放进vector
+// 查找时按字段名不区分大小写比较，请求头个数很少，线性扫描比哈希更快
+class HeaderTable {
+public:
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct Entry {
+        Span name;
+        Span value;
+    };
+    static const size_t INLINE_SIZE = 32;
+
+    HeaderTable() : count_(0) {}
+
+    void Clear() {
+        count_ = 0;
+        overflow_.clear();
+    }
+
+    void Add(Span name, Span value) {
+        Entry entry = {name, value};
+        if(count_ < INLINE_SIZE)
+        {
+            inline_[count_++] = entry;
+        }
+        else
+        {
+            overflow_.push_back(entry);
+        }
+    }
+
+    size_t Size() const { return count_ + overflow_.size(); }
+
+    const Entry& At(size_t i) const {
+        return i < count_ ? inline_[i] : overflow_[i - count_];
+    }
+
+    // base是当前的Buffer首地址（Buffer扩容后会变，所以每次查找都要传进来）
+    // 同名字段出现多次时返回第一个
+    const Entry* Find(const char* base, const char* name, size_t len) const {
+        for(size_t i = 0; i < Size(); i++)
+        {
+            const Entry& entry = At(i);
+            if(StrView(base + entry.name.off, entry.name.len).EqualsIgnoreCase(name, len))
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    Entry inline_[INLINE_SIZE];
+    size_t count_;
+    std::vector<Entry> overflow_;
+};
+
+#endif
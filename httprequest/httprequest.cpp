@@ -1,108 +1,733 @@
 #include "httprequest.h"
 using namespace std;
 
-
-//这是一个无序集合，保存了一组常用的网页路径（如首页、注册、登录等）。
-//作用：用于快速判断某个请求路径是否属于这些“默认页面”，比如判断用户请求的 URL 是否是这些页面之一。
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-    "/index",
-    "/register",
-    "/login",
-    "/welcome",
-    "/viedo",
-    "/picture",
-};
-
-//这是一个无序映射表，将特定的 HTML 页面路径映射为一个整数标签（如注册页为 0，登录页为 1）。
-//作用：用于根据页面路径快速获取对应的类型编号，方便后续逻辑处理（比如区分注册和登录页面）。
-const unordered_map<string,int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0},
-    {"/login.html", 1}, 
-};
+//默认页面和需要用户验证的页面见httptables.h，编译期写死的switch查表
 
 void HttpRequest::Init(){
-    method_="";
+    if(pinned_)//上一个请求处理完了，Buffer可以正常整理空间了
+    {
+        buf_->Unpin();
+        pinned_ = false;
+    }
+    buf_ = nullptr;
+    zeroCopy_ = wantZeroCopy_;
+    method_ = METHOD_UNKNOWN;
     path_="";
-    version_="";
-    body_="";
+    version_ = StrView();
     state_=REQUEST_LINE;
-    headers_.clear();
-    post_.clear();
+    errorCode_ = 400;
+    scanned_ = 0;
+    contentLength_ = 0;
+    bodyState_ = BODY_LENGTH;
+    bodyLeft_ = 0;
+    bodySize_ = 0;
+    inlineBody_ = false;
+    sink_ = nullptr;
+    memSink_.Reset();
+    fileSink_.Reset();//关闭上一个请求的临时文件
+    formSink_.Reset();
+    headers_.Clear();
+    knownMask_ = 0;
+    dupMask_ = 0;
+    memset(knownIndex_, 0, sizeof(knownIndex_));
+    post_.Clear();
+    arena_.Reset();//上面的列表和视图都指向arena_，要先清掉
+    pathOwned_ = false;
+    pathSpan_ = versionSpan_ = bodySpan_ = Span();
+    headerTable_.Clear();
 }
 
 bool HttpRequest::IsKeepAlive() const{
-    if(headers_.find("connection")!= headers_.end())
+    StrView connection = Header(HEADER_CONNECTION);
+    return connection.Equals("keep-alive") && VersionView().Equals("1.1");
+}
+
+StrView HttpRequest::Header(const char* key) const{
+    assert(key);
+    size_t len = strlen(key);
+    HttpHeader id = HttpTables::LookupHeader(key, len);
+    if(id != HEADER_UNKNOWN)//常用字段不用扫描或哈希
     {
-        return headers_.find("connection")->second == "keep-alive" &&
-                version_ == "1.1";
+        return Header(id);
     }
-    return false;
+    if(zeroCopy_)
+    {
+        const HeaderTable::Entry* entry = buf_ ? headerTable_.Find(buf_->AtOffset(0), key, len) : nullptr;
+        return entry ? View(entry->value) : StrView();
+    }
+    for(size_t i = 0; i < headers_.Size(); i++)//同名字段取第一个，和零拷贝模式的HeaderTable::Find一致
+    {
+        if(headers_[i].name.EqualsIgnoreCase(key, len))
+        {
+            return headers_[i].value;
+        }
+    }
+    return StrView();
 }
 
+StrView HttpRequest::Header(HttpHeader id) const{
+    assert(id > HEADER_UNKNOWN && id < HEADER_COUNT);
+    if(zeroCopy_)
+    {
+        return knownIndex_[id] ? View(headerTable_.At(knownIndex_[id] - 1).value) : StrView();
+    }
+    return knownMask_ & (1u << id) ? knownValues_[id] : StrView();
+}
 
+StrView HttpRequest::Body() const{
+    if(inlineBody_)
+    {
+        return View(bodySpan_);
+    }
+    return sink_ == &memSink_ ? StrView(memSink_.Data()) : StrView();
+}
+
+int HttpRequest::BodyFd() const{
+    return sink_ == &fileSink_ ? fileSink_.Fd() : -1;
+}
+
+HeaderTable::Span HttpRequest::ToSpan(const char* begin, const char* end) const{
+    Span span = {static_cast<uint32_t>(buf_->OffsetOf(begin)), static_cast<uint32_t>(end - begin)};
+    return span;
+}
+
+//每次都用Buffer当前的首地址换算，Buffer钉住期间扩容也不影响
+StrView HttpRequest::View(const Span& span) const{
+    if(!buf_)
+    {
+        return StrView();
+    }
+    return StrView(buf_->AtOffset(span.off), span.len);
+}
+
+StrView HttpRequest::MethodView() const{
+    const char* name = HttpTables::MethodName(method_);
+    return StrView(name, strlen(name));
+}
+
+StrView HttpRequest::PathView() const{
+    return zeroCopy_ && !pathOwned_ ? View(pathSpan_) : StrView(path_);
+}
+
+StrView HttpRequest::VersionView() const{
+    return zeroCopy_ ? View(versionSpan_) : version_;
+}
+
+//可重入的增量解析：数据不完整时返回true并保持当前状态，下次ReadFd之后接着解析
+//每次只消费一个完整的请求，同一个Buffer里后面流水线发来的请求原样留在Buffer中
+//返回false表示请求格式错误
+//按行扫描[peek(), BeginWriteConst())，要求Buffer是连续模式：分段模式下这两个指针在不同的块里
 bool HttpRequest::Parse(Buffer& buffer){
-    const char CRLF[]= "\r\n";//行结束符标志(回车换行)
-    if(buffer.ReadableBytes()<0)
+    assert(!buffer.IsChained());
+    if(buffer.IsChained())
     {
+        LOG_ERROR("Parse needs a contiguous buffer");
         return false;
     }
-    //读取数据
-    while(buffer.ReadableBytes()&& state_!=FINISH)
+    if(zeroCopy_ && !pinned_)//零拷贝：记下的偏移在请求处理完之前必须一直有效
     {
-        //从buff中的读指针开始到读指针结束，这块区域是未读取得数据并去处"\r\n"，返回有效数据得行末指针
-        //找到 buffer 中一行数据的结尾（即 "\r\n" 的位置），用于按行解析 HTTP 请求。
-        const char* lineEnd = search(buffer.peek(),buffer.BeginWriteConst(),CRLF,CRLF+2);
-        //转化为string类型
-        std::string line(buffer.peek(),lineEnd);
+        buffer.Pin();
+        pinned_ = true;
+        buf_ = &buffer;
+    }
+    while(state_ != FINISH)
+    {
+        if(state_ == BODY && (bodyState_ == BODY_LENGTH || bodyState_ == CHUNK_DATA))//请求体数据不按行
+        {
+            if(!ParseBodyData_(buffer))
+            {
+                return false;
+            }
+            if(state_ == BODY && bodyLeft_ > 0)
+            {
+                break;//请求体还没收全，等下一次ReadFd
+            }
+            continue;
+        }
+        //从上次扫描到的位置继续找"\r\n"，不重复扫描已经确认没有行尾的部分
+        //记的是相对读指针的偏移，Buffer在两次调用之间扩容或整理空间都不影响
+        const char* begin = buffer.peek();
+        const char* end = buffer.BeginWriteConst();
+        const char* from = begin + (scanned_ > 0 ? scanned_ - 1 : 0);//上次最后一个字节可能是'\r'，要重看
+        const char* lineEnd = HttpScan::FindCRLF(from, end);//向量化扫描，代替std::search
+        if(lineEnd == end)//这一行还没收全
+        {
+            scanned_ = end - begin;
+            if(scanned_ > MAX_LINE)
+            {
+                LOG_ERROR("Request line or header too long");
+                return false;
+            }
+            break;
+        }
+        scanned_ = 0;
+        if(static_cast<size_t>(lineEnd - begin) > MAX_LINE)//一次读进来的完整长行也要拦住
+        {
+            LOG_ERROR("Request line or header too long");
+            return false;
+        }
+        //直接在Buffer上按[begin, lineEnd)解析，不再为每一行构造string
         switch(state_)
         {
             /*
             有限状态机，从请求行开始，每处理完后会自动转入到下一个状态    
             */
-           case REQUEST_LINE:
-                if(!ParseRequestLine(line))
+            case REQUEST_LINE:
+                if(begin == lineEnd)//请求之间多余的空行直接跳过（RFC 7230 3.5）
+                {
+                    break;
+                }
+                if(!ParseRequestLine(begin, lineEnd))
                 {
                     return false;
                 }
                 ParsePath_();//解析路径
                 break;
             case HEADERS:
-                ParseHeader(line);//解析请求头
-                if(buffer.ReadableBytes()<=2)
+                if(begin == lineEnd)//空行，请求头结束
+                {
+                    if(!ParseHeadersEnd_())
+                    {
+                        return false;
+                    }
+                }
+                else if(!ParseHeader(begin, lineEnd))//解析请求头
                 {
-                    state_ = FINISH;
+                    return false;
                 }
                 break;
             case BODY:
-                ParseBody(line);//解析请求体
+                if(!ParseChunkLine_(begin, lineEnd))
+                {
+                    return false;
+                }
                 break;
             default:
                 break;
         }
-        if(lineEnd == buffer.BeginWriteConst())
-        {
-            break;
-        }//如果行末指针等于读指针，说明没有数据了
         buffer.retrieveUntil(lineEnd + 2);//把读过的数据取走（跳过回车换行）
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
+    if(state_ == FINISH)
+    {
+        LOG_DEBUG("[%.*s], [%.*s], [%.*s]", static_cast<int>(MethodView().size), MethodView().data,
+                  static_cast<int>(PathView().size), PathView().data, static_cast<int>(VersionView().size), VersionView().data);
+    }
+    return true;
+}
+
+//一次从Buffer里解析出多个流水线请求：reqs[0]开始依次接着解析，直到数据不够或者reqs用完
+//返回解析完成（FINISH）的个数n；若n < maxReqs且reqs[n]解析了一半，调用者应保留它，下次从它开始
+//reqs里已经完成的请求处理完之后由调用者Init()
+int HttpRequest::ParsePipeline(Buffer& buffer, HttpRequest* reqs, int maxReqs){
+    assert(reqs && maxReqs > 0);
+    int done = 0;
+    while(done < maxReqs)
+    {
+        HttpRequest& req = reqs[done];
+        if(!req.IsFinished())
+        {
+            if(!req.Parse(buffer))
+            {
+                return -1;
+            }
+            if(!req.IsFinished())
+            {
+                break;
+            }
+        }
+        done++;
+    }
+    return done;
+}
+
+//请求头收完：根据Content-Length或Transfer-Encoding决定是否还要收请求体
+bool HttpRequest::ParseHeadersEnd_(){
+    StrView length = Header(HEADER_CONTENT_LENGTH);
+    StrView encoding = Header(HEADER_TRANSFER_ENCODING);
+    bool chunked = !encoding.empty();
+    //重复的Content-Length或Transfer-Encoding只解析了一个，前后两跳各取一个就会切出不同的请求（请求走私）
+    if(dupMask_ & ((1u << HEADER_CONTENT_LENGTH) | (1u << HEADER_TRANSFER_ENCODING)))
+    {
+        LOG_ERROR("Repeated Content-Length or Transfer-Encoding");
+        return false;
+    }
+    if(chunked && !encoding.EqualsIgnoreCase("chunked"))
+    {
+        LOG_ERROR("Unsupported Transfer-Encoding");
+        return false;
+    }
+    if(chunked && !length.empty())//两个都有时无法确定请求边界（RFC 7230 3.3.3）
+    {
+        LOG_ERROR("Both Content-Length and Transfer-Encoding");
+        return false;
+    }
+    contentLength_ = 0;
+    for(size_t i = 0; i < length.size; i++)
+    {
+        char ch = length.data[i];
+        if(ch < '0' || ch > '9')
+        {
+            LOG_ERROR("Bad Content-Length");
+            return false;
+        }
+        if(contentLength_ > MAX_BODY)//已经超了，后面只检查是不是数字，不再乘，防止溢出；下面回413
+        {
+            continue;
+        }
+        contentLength_ = contentLength_ * 10 + (ch - '0');
+    }
+    bool form = method_ == METHOD_POST && Header(HEADER_CONTENT_TYPE).Equals("application/x-www-form-urlencoded");
+    if(contentLength_ > MAX_BODY || (form && !userSink_ && contentLength_ > MAX_FORM_BODY))
+    {
+        LOG_ERROR("Body too large");
+        errorCode_ = 413;
+        return false;
+    }
+    if(!chunked && contentLength_ == 0)
+    {
+        state_ = FINISH;
+        return true;
+    }
+    state_ = BODY;
+    bodyState_ = chunked ? CHUNK_SIZE : BODY_LENGTH;
+    bodyLeft_ = chunked ? 0 : contentLength_;
+    //零拷贝模式下小的请求体等收全了直接用偏移访问；其余情况边收边交给sink，Buffer里不留请求体
+    inlineBody_ = zeroCopy_ && !chunked && !userSink_ && contentLength_ <= MEMORY_BODY;
+    if(!inlineBody_)
+    {
+        if(zeroCopy_)//钉住的Buffer不能整理空间，大请求体会把它撑大
+        {
+            Detach_();
+        }
+        sink_ = SelectSink_();
+        sink_->Reset();
+    }
+    return true;
+}
+
+BodySink* HttpRequest::SelectSink_(){
+    if(userSink_)
+    {
+        return userSink_;
+    }
+    if(method_ == METHOD_POST && Header(HEADER_CONTENT_TYPE).Equals("application/x-www-form-urlencoded"))
+    {
+        return &formSink_;
+    }
+    return &memSink_;
+}
+
+void HttpRequest::Detach_(){
+    if(!pathOwned_)
+    {
+        path_ = View(pathSpan_).ToString();
+        pathOwned_ = true;
+    }
+    StrView version = View(versionSpan_);
+    version_ = arena_.Copy(version.data, version.size);
+    for(size_t i = 0; i < headerTable_.Size(); i++)
+    {
+        const HeaderTable::Entry& entry = headerTable_.At(i);
+        StrView name = View(entry.name);
+        StrView value = View(entry.value);
+        HttpHeader id = HttpTables::LookupHeader(name.data, name.size);
+        if(id != HEADER_UNKNOWN)
+        {
+            if(knownIndex_[id] == i + 1)//同名字段取第一个
+            {
+                knownValues_[id] = arena_.Copy(value.data, value.size);
+                knownMask_ |= 1u << id;
+            }
+            continue;
+        }
+        Field field = {arena_.CopyLower(name.data, name.size), arena_.Copy(value.data, value.size)};
+        headers_.Push(arena_, field);
+    }
+    headerTable_.Clear();
+    zeroCopy_ = false;
+    buf_->Unpin();
+    pinned_ = false;
+    buf_ = nullptr;
+}
+
+bool HttpRequest::ParseBodyData_(Buffer& buffer){
+    size_t readable = buffer.ReadableBytes();
+    if(inlineBody_)
+    {
+        if(readable < bodyLeft_)
+        {
+            return true;
+        }
+        bodySpan_ = ToSpan(buffer.peek(), buffer.peek() + bodyLeft_);
+        bodySize_ = bodyLeft_;
+        buffer.retrieve(bodyLeft_);
+        bodyLeft_ = 0;
+        return FinishBody_();
+    }
+    size_t n = std::min(readable, bodyLeft_);
+    if(n > 0)
+    {
+        if(!WriteBody_(buffer.peek(), n))
+        {
+            return false;
+        }
+        buffer.retrieve(n);
+        bodyLeft_ -= n;
+    }
+    if(bodyLeft_ > 0)
+    {
+        return true;
+    }
+    if(bodyState_ == BODY_LENGTH)
+    {
+        return FinishBody_();
+    }
+    bodyState_ = CHUNK_CRLF;
+    return true;
+}
+
+//chunked编码：十六进制大小[;扩展]\r\n 数据\r\n ... 0\r\n [trailer\r\n] \r\n
+bool HttpRequest::ParseChunkLine_(const char* begin, const char* end){
+    switch(bodyState_)
+    {
+        case CHUNK_SIZE:
+        {
+            size_t size = 0;
+            const char* p = begin;
+            for(; p < end && *p != ';' && *p != ' ' && *p != '\t'; p++)
+            {
+                int v = ConverHex(*p);
+                if(v < 0 || size > MAX_BODY)
+                {
+                    LOG_ERROR("Bad chunk size");
+                    return false;
+                }
+                size = size * 16 + v;
+            }
+            if(p == begin)
+            {
+                LOG_ERROR("Bad chunk size");
+                return false;
+            }
+            if(size > MAX_BODY - bodySize_)
+            {
+                LOG_ERROR("Body too large");
+                errorCode_ = 413;
+                return false;
+            }
+            bodyLeft_ = size;
+            bodyState_ = size > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+            return true;
+        }
+        case CHUNK_CRLF:
+            if(begin != end)
+            {
+                LOG_ERROR("Bad chunk terminator");
+                return false;
+            }
+            bodyState_ = CHUNK_SIZE;
+            return true;
+        case CHUNK_TRAILER:
+            if(begin == end)
+            {
+                return FinishBody_();
+            }
+            return true;//trailer字段不处理
+        default:
+            return false;
+    }
+}
+
+//默认的内存sink满了就把已经收到的部分转存到临时文件，之后都写文件，每个连接占的内存有上限
+bool HttpRequest::WriteBody_(const char* data, size_t len){
+    if(len > MAX_BODY - bodySize_)
+    {
+        LOG_ERROR("Body too large");
+        errorCode_ = 413;
+        return false;
+    }
+    bodySize_ += len;
+    if(sink_ == &memSink_ && len > MEMORY_BODY - memSink_.Size())
+    {
+        if(!fileSink_.Write(memSink_.Data().data(), memSink_.Size()))
+        {
+            LOG_ERROR("Spill body to file failed, errno:%d", errno);
+            return false;
+        }
+        memSink_.Reset();
+        sink_ = &fileSink_;
+    }
+    if(!sink_->Write(data, len))
+    {
+        LOG_ERROR("Body sink rejected %d bytes", static_cast<int>(len));
+        if(sink_ == &formSink_ && formSink_.TooLarge())
+        {
+            errorCode_ = 413;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool HttpRequest::FinishBody_(){
+    if(sink_ && !sink_->Finish())
+    {
+        LOG_ERROR("Body sink finish failed");
+        if(sink_ == &formSink_ && formSink_.TooLarge())
+        {
+            errorCode_ = 413;
+        }
+        return false;
+    }
+    if(!ParsePost_())
+    {
+        return false;
+    }
+    state_ = FINISH;
+    LOG_DEBUG("Body len:%d", static_cast<int>(bodySize_));
     return true;
 }
 
 //解析路径
 void HttpRequest::ParsePath_(){
-    if(path_ == "/")//如果请求路径是根目录
+    StrView path = PathView();
+    if(path.Equals("/"))//如果请求路径是根目录
     {
         path_ = "/index.html";//默认首页
+        pathOwned_ = true;
+    }
+    else if(const char* html = HttpTables::LookupDefaultHtml(path))
+    {
+        path_ = html;//如果请求路径是默认路径，添加后缀
+        pathOwned_ = true;
+    }
+}
+
+//解析请求行，格式为：方法 空格 路径 空格 HTTP/版本，例如 GET /index.html HTTP/1.1
+bool HttpRequest::ParseRequestLine(const char* begin, const char* end){
+    const char* sp1 = HttpScan::FindChar(begin, end, ' ');
+    const char* sp2 = sp1 == end ? end : HttpScan::FindChar(sp1 + 1, end, ' ');
+    if(sp1 == begin || sp2 == end || sp2 == sp1 + 1 || end - sp2 - 1 <= 5 || memcmp(sp2 + 1, "HTTP/", 5) != 0)
+    {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    method_ = HttpTables::LookupMethod(begin, sp1 - begin);
+    if(method_ == METHOD_UNKNOWN)
+    {
+        LOG_ERROR("Unknown method");
+        return false;
+    }
+    if(zeroCopy_)
+    {
+        pathSpan_ = ToSpan(sp1 + 1, sp2);
+        versionSpan_ = ToSpan(sp2 + 6, end);
     }
     else
     {
-        for(auto &item:DEFAULT_HTML)
+        path_.assign(sp1 + 1, sp2);
+        version_ = arena_.Copy(sp2 + 6, end - sp2 - 6);
+    }
+    state_ = HEADERS;
+    return true;
+}
+
+//解析请求头，格式为：字段名: 值
+//常用字段先查表得到ID，按ID单独存放；其余字段普通模式下字段名转成小写复制进arena_，零拷贝模式只记偏移
+//没有冒号、字段名为空或者带空白（包括冒号前的空白）时返回false，回400（RFC 7230 3.2.4）：
+//"Content-Length : 5"如果当成未知字段忽略，请求体会被当成下一个流水线请求解析
+bool HttpRequest::ParseHeader(const char* begin, const char* end){
+    const char* colon = HttpScan::FindChar(begin, end, ':');
+    if(colon == end || colon == begin)
+    {
+        LOG_ERROR("Bad header line");
+        return false;
+    }
+    for(const char* p = begin; p < colon; p++)
+    {
+        if(*p == ' ' || *p == '\t')
+        {
+            LOG_ERROR("Whitespace in header name");
+            return false;
+        }
+    }
+    const char* value = colon + 1;
+    while(value < end && (*value == ' ' || *value == '\t'))//跳过冒号后面的空白
+    {
+        value++;
+    }
+    HttpHeader id = HttpTables::LookupHeader(begin, colon - begin);
+    if(zeroCopy_)
+    {
+        headerTable_.Add(ToSpan(begin, colon), ToSpan(value, end));
+        if(id != HEADER_UNKNOWN && knownIndex_[id])
+        {
+            dupMask_ |= 1u << id;
+        }
+        else if(id != HEADER_UNKNOWN)//同名字段出现多次时取第一个，和HeaderTable::Find一致
+        {
+            knownIndex_[id] = static_cast<uint32_t>(headerTable_.Size());
+        }
+        return true;
+    }
+    if(id != HEADER_UNKNOWN)
+    {
+        if(knownMask_ & (1u << id))
         {
-            if(path_ == item)
+            dupMask_ |= 1u << id;
+        }
+        else//两种模式都取第一个，同一个请求不会因为模式不同而分帧不同
+        {
+            knownValues_[id] = arena_.Copy(value, end - value);
+            knownMask_ |= 1u << id;
+        }
+        return true;
+    }
+    Field field = {arena_.CopyLower(begin, colon - begin), arena_.Copy(value, end - value)};
+    headers_.Push(arena_, field);
+    return true;
+}
+
+//十六进制字符转为对应的数值
+int HttpRequest::ConverHex(char ch){
+    if(ch >= 'A' && ch <= 'F')
+    {
+        return ch - 'A' + 10;
+    }
+    if(ch >= 'a' && ch <= 'f')
+    {
+        return ch - 'a' + 10;
+    }
+    if(ch >= '0' && ch <= '9')
+    {
+        return ch - '0';
+    }
+    return -1;
+}
+
+//处理POST请求：表单提交到注册/登录页时做用户验证，并根据结果跳转
+bool HttpRequest::ParsePost_(){
+    if(method_ == METHOD_POST && Header(HEADER_CONTENT_TYPE).Equals("application/x-www-form-urlencoded"))
+    {
+        if(inlineBody_ && !ParseFromUrlencoded_())//其余情况收请求体时已经由formSink_解码进post_
+        {
+            LOG_ERROR("Form too large");
+            errorCode_ = 413;
+            return false;
+        }
+        int tag = HttpTables::LookupHtmlTag(PathView());
+        if(tag >= 0)
+        {
+            LOG_DEBUG("Tag:%d", tag);
+            bool isLogin = (tag == 1);
+            if(UserVerify(GetPost("username"), GetPost("password"), isLogin))
             {
-                path_ += ".html";//如果请求路径是默认路径，添加后缀
-                break;
-            }     
+                path_ = "/welcome.html";
+            }
+            else
+            {
+                path_ = "/error.html";
+            }
+            pathOwned_ = true;
+        }
+    }
+    return true;
+}
+
+//按application/x-www-form-urlencoded格式解码请求体：key=value&key=value，'+'是空格，%XX是转义字符
+bool HttpRequest::ParseFromUrlencoded_(){
+    StrView body = Body();
+    formSink_.Reset();
+    return formSink_.Write(body.data, body.size) && formSink_.Finish();
+}
+
+//用户验证：登录时比对密码，注册时检查用户名是否已被占用，没有则插入
+bool HttpRequest::UserVerify(const std::string& user, const std::string& passwd, bool isLogin){
+    if(user.empty() || passwd.empty())
+    {
+        return false;
+    }
+    LOG_INFO("Verify name:%s", user.c_str());
+    AuthCache* cache = AuthCache::Instance();
+    if(isLogin && cache->Verify(user, passwd))//最近验证过，不用再查用户存储
+    {
+        LOG_DEBUG("Auth cache hit");
+        return true;
+    }
+    if(!isLogin)
+    {
+        cache->Invalidate(user);
+    }
+    //走当前配置的用户存储：MySQL或者进程内引擎
+    UserStore* store = UserStore::Instance();
+    bool flag = false;
+    if(isLogin)//登录：密码一致才通过
+    {
+        std::string stored;
+        int found = store->Find(user, &stored);
+        flag = found > 0 && passwd == stored;
+        if(found >= 0 && !flag)
+        {
+            LOG_DEBUG("pwd error!");
+        }
+    }
+    else//注册：用户名没被占用才插入
+    {
+        int added = store->Add(user, passwd);
+        flag = added > 0;
+        if(added == 0)
+        {
+            LOG_DEBUG("user used!");
+        }
+    }
+    if(flag)
+    {
+        cache->Insert(user, passwd);
+    }
+    return flag;
+}
+
+std::string HttpRequest::Path() const{
+    return PathView().ToString();
+}
+
+std::string& HttpRequest::Path(){
+    if(zeroCopy_ && !pathOwned_)//要返回引用，只能先把路径复制出来
+    {
+        path_ = View(pathSpan_).ToString();
+        pathOwned_ = true;
+    }
+    return path_;
+}
+
+std::string HttpRequest::Method() const{
+    return MethodView().ToString();
+}
+
+std::string HttpRequest::version(){
+    return VersionView().ToString();
+}
+
+std::string HttpRequest::GetPost(const std::string& key) const{
+    assert(key != "");
+    return Post(key.c_str()).ToString();
+}
+
+std::string HttpRequest::GetPost(const char* key) const{
+    assert(key != nullptr);
+    return Post(key).ToString();
+}
+
+//表单字段很少，线性查找；同名字段取最后一个
+StrView HttpRequest::Post(const char* key) const{
+    assert(key != nullptr);
+    size_t len = strlen(key);
+    for(size_t i = post_.Size(); i > 0; i--)
+    {
+        if(post_[i - 1].name.Equals(key, len))
+        {
+            return post_[i - 1].value;
+        }
     }
+    return StrView();
 }
@@ -2,15 +2,20 @@
 #define HTTPREQUEST_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
 #include <regex>
 #include <errno.h>
-#include <mysql/mysql.h>
 
 #include "../buffer/buffer.h"
+#include "httpscan.h"
+#include "strview.h"
+#include "headertable.h"
+#include "httptables.h"
+#include "bodysink.h"
+#include "arena.h"
+#include "authcache.h"
 #include "../log/log.h"
-#include "../poll/sqlconnpool.h"
+#include "../userstore/userstore.h"
 
 class HttpRequest{
 public:
@@ -21,40 +26,132 @@ public:
         FINISH,
     };
 
-    HttpRequest() {Init();}
+    HttpRequest() : wantZeroCopy_(false), pinned_(false), buf_(nullptr), userSink_(nullptr) {
+        formSink_.SetOutput([this](const std::string& key, const std::string& value) {
+            Field field = {arena_.Copy(key.data(), key.size()), arena_.Copy(value.data(), value.size())};
+            post_.Push(arena_, field);
+        });
+        formSink_.SetLimits(MAX_FORM_BODY, MAX_FORM_FIELDS);
+        Init();
+    }
     ~HttpRequest() = default;
+    HttpRequest(const HttpRequest&) = delete;
+    HttpRequest& operator=(const HttpRequest&) = delete;
 
-    void Init();
-    bool Parse(Buffer& buffer);
+    void Init();//开始下一个请求，零拷贝模式下同时解除对上一个Buffer的钉住
+    bool Parse(Buffer& buffer);//增量解析，数据不完整时保持状态，下次接着解析；Buffer必须是连续模式
+    static int ParsePipeline(Buffer& buffer, HttpRequest* reqs, int maxReqs);//一次解析多个流水线请求，出错返回-1
+    bool IsFinished() const {return state_ == FINISH;}
+    int ErrorCode() const {return errorCode_;}//Parse返回false时该回的状态码：请求体超过上限是413，其余是400
+    PARSE_STATE State() const {return state_;}
+
+    //零拷贝模式：请求行、请求头、请求体都不复制，只记录在Buffer中的偏移，Buffer在Init()之前一直被钉住
+    //要求Buffer是连续模式；在Init()之后、第一次Parse()之前设置
+    //请求体较大或者是chunked时，收请求体之前会把请求行和请求头复制出来并解除钉住，请求体走sink
+    void SetZeroCopy(bool on) {wantZeroCopy_ = zeroCopy_ = on;}
+    bool IsZeroCopy() const {return wantZeroCopy_;}
+
+    //请求体默认的去处：表单（POST + urlencoded）增量解码进post_；其余先放内存，超过MEMORY_BODY转存临时文件
+    //设置了sink时请求体全部交给它，一直有效直到再次设置；调用者保证sink比请求活得久
+    void SetBodySink(BodySink* sink) {userSink_ = sink;}
+
+    StrView Header(const char* key) const;//按字段名查请求头，不区分大小写，没有时返回空视图
+    StrView Header(HttpHeader id) const;//常用请求头按ID直接取，O(1)
+    StrView Body() const;//请求体在内存中时返回内容，转存到文件或交给了其他sink时为空
+    int BodyFd() const;//请求体转存到临时文件时返回fd（已经seek到开头），否则返回-1
+    size_t BodySize() const {return bodySize_;}
 
     std::string Path() const;//用于只读访问，安全，不会改变对象内部状态。
     std::string & Path();//（返回引用）用于需要修改成员变量的场景，效率高，但要注意不要返回局部变量的引用。
     std::string Method() const;
+    HttpMethod MethodId() const {return method_;}
     std::string version();
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
+    StrView Post(const char* key) const;//不复制，视图在Init()之前有效
+    size_t ArenaHighWater() const {return arena_.HighWater();}//请求状态占用内存的历史最大值，用来估计Arena的大小
 
     bool IsKeepAlive() const;
 
 private:
-    bool ParseRequestLine(const std::string& line);//解析请求行
-    void ParseHeader(const std::string& line);//解析请求头
-    void ParseBody(const std::string& line);//解析请求体
+    typedef HeaderTable::Span Span;
+    struct Field {//字段名和值都在arena_里
+        StrView name;
+        StrView value;
+    };
+
+    bool ParseRequestLine(const char* begin, const char* end);//解析请求行
+    bool ParseHeader(const char* begin, const char* end);//解析请求头，格式不对时返回false
+    bool ParseBodyData_(Buffer& buffer);//收Content-Length的请求体或者一个chunk的数据
+    bool ParseChunkLine_(const char* begin, const char* end);//chunk大小行、chunk后的空行、trailer
+    bool WriteBody_(const char* data, size_t len);//解码后的请求体交给sink
+    bool FinishBody_();
+    BodySink* SelectSink_();
+    void Detach_();//零拷贝模式下把请求行和请求头复制出来，解除对Buffer的钉住
+    bool ParseHeadersEnd_();//请求头结束，读Content-Length
+
+    Span ToSpan(const char* begin, const char* end) const;//零拷贝模式：指针 -> Buffer内的偏移
+    StrView View(const Span& span) const;//零拷贝模式：偏移 -> 视图
+    StrView MethodView() const;
+    StrView PathView() const;
+    StrView VersionView() const;
 
     void ParsePath_();//解析路径
-    void ParsePost_();//解析Post事件
-    void ParseFromUrlencoded_();//从url处解析编码
+    bool ParsePost_();//解析Post事件，表单超过上限时返回false
+    bool ParseFromUrlencoded_();//零拷贝模式下请求体整个在Buffer里，一次性解码
  
     //表示这是一个静态成员函数 不依赖于类的对象：不需要访问或修改某个 HttpRequest 对象的成员变量。你可以直接用 HttpRequest::UserVerify(...) 调用，
     static bool UserVerify(const std::string& user, const std::string& passwd,bool isLogin);//用户验证
     
+    static const size_t MAX_LINE = 8192;//请求行/单个请求头的最大长度
+    static const size_t MAX_BODY = 64 * 1024 * 1024;//请求体的最大长度
+    static const size_t MEMORY_BODY = 64 * 1024;//请求体超过这个大小就转存临时文件；零拷贝模式下不超过它的才直接留在Buffer里
+    static const size_t MAX_FORM_BODY = 1024 * 1024;//表单解码进post_，整个放在内存里，单独限制总长度和字段数
+    static const size_t MAX_FORM_FIELDS = 1024;
+
+    enum BODY_STATE{
+        BODY_LENGTH,//按Content-Length收
+        CHUNK_SIZE,//等chunk大小行
+        CHUNK_DATA,
+        CHUNK_CRLF,//chunk数据后面的"\r\n"
+        CHUNK_TRAILER,//最后一个chunk后面的trailer，空行结束
+    };
+
     PARSE_STATE state_;//解析状态
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string,std::string> headers_;//请求头
-    std::unordered_map<std::string,std::string> post_;//请求体
+    int errorCode_;
+    size_t scanned_;//当前行已经扫描过、确认没有"\r\n"的字节数（相对读指针）
+    size_t contentLength_;//请求体长度
+    BODY_STATE bodyState_;
+    size_t bodyLeft_;//当前请求体（或当前chunk）还差的字节数
+    size_t bodySize_;//已经收到的请求体字节数（chunked解码后）
+    bool inlineBody_;//零拷贝模式下请求体直接留在Buffer里，用bodySpan_访问
+    HttpMethod method_;//请求方法，解析请求行时查表得到
+    //请求的字段都从arena_分配，Init()时整体回卷，keep-alive连接上不再为每个请求malloc/free
+    //path_要通过Path()返回引用，仍然是string（容量在请求之间复用）
+    Arena arena_;
+    std::string path_;
+    StrView version_;
+    ArenaList<Field> headers_;//普通模式下的请求头（不在HttpHeader里的字段），字段名已转成小写
+    StrView knownValues_[HEADER_COUNT];//普通模式下常用请求头的值
+    uint32_t knownMask_;//普通模式下knownValues_中哪些有值
+    uint32_t dupMask_;//哪些常用请求头出现了不止一次（两种模式都记）
+    uint32_t knownIndex_[HEADER_COUNT];//零拷贝模式下常用请求头在headerTable_中的下标+1，0表示没有
+
+    bool wantZeroCopy_;//SetZeroCopy设置的值，Init()时恢复
+    bool zeroCopy_;//当前请求是否还在零拷贝解析（Detach_之后为false）
+    bool pinned_;//是否钉住了buf_
+    Buffer* buf_;//零拷贝模式下字段所在的Buffer
+    bool pathOwned_;//零拷贝模式下路径是否已经复制到path_（被改写或被Path()取了引用）
+    Span pathSpan_, versionSpan_, bodySpan_;
+    HeaderTable headerTable_;//零拷贝模式下的请求头
+    ArenaList<Field> post_;//表单字段
+
+    BodySink* userSink_;//SetBodySink设置的sink
+    BodySink* sink_;//当前请求体正在写入的sink
+    MemoryBodySink memSink_;
+    FileBodySink fileSink_;
+    UrlencodedBodySink formSink_;
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;//默认文件
-    static const std::unordered_map<std::string,int> DEFAULT_HTML_TAG;//默认文件类型
     static int ConverHex(char ch);//十六进制转为十进制
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "httpscan.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTPSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef const char* (*FindCRLFFunc)(const char*, const char*);
+typedef const char* (*FindCharFunc)(const char*, const char*, char);
+
+const char* HttpScan::FindCRLFScalar(const char* begin, const char* end){
+    for(const char* p = begin; p + 1 < end; p++)
+    {
+        if(p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char* HttpScan::FindCharScalar(const char* begin, const char* end, char c){
+    for(const char* p = begin; p < end; p++)
+    {
+        if(*p == c)
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef HTTPSCAN_X86
+
+//一次比较16字节：p处的'\r'和p+1处的'\n'同时成立的位就是行尾
+__attribute__((target("sse2")))
+const char* HttpScan::FindCRLFSSE2(const char* begin, const char* end){
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    for(; p + 17 <= end; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if(mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindCRLFScalar(p, end);//不足一组的尾巴逐字节处理
+}
+
+__attribute__((target("sse2")))
+const char* HttpScan::FindCharSSE2(const char* begin, const char* end, char c){
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 16 <= end; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, needle));
+        if(mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindCharScalar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char* HttpScan::FindCRLFAVX2(const char* begin, const char* end){
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    for(; p + 33 <= end; p += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+        if(mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindCRLFSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* HttpScan::FindCharAVX2(const char* begin, const char* end, char c){
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 32 <= end; p += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle)));
+        if(mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindCharSSE2(p, end, c);
+}
+
+static bool HasAVX2(){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool HasSSE2(){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+#else
+
+const char* HttpScan::FindCRLFSSE2(const char* begin, const char* end){
+    return FindCRLFScalar(begin, end);
+}
+
+const char* HttpScan::FindCharSSE2(const char* begin, const char* end, char c){
+    return FindCharScalar(begin, end, c);
+}
+
+const char* HttpScan::FindCRLFAVX2(const char* begin, const char* end){
+    return FindCRLFScalar(begin, end);
+}
+
+const char* HttpScan::FindCharAVX2(const char* begin, const char* end, char c){
+    return FindCharScalar(begin, end, c);
+}
+
+static bool HasAVX2(){
+    return false;
+}
+
+static bool HasSSE2(){
+    return false;
+}
+
+#endif
+
+//运行时分派：函数指针一开始指向Resolve，第一次调用时检测CPU并把指针换成选中的实现，
+//之后每次调用只是一次relaxed load加间接调用，没有静态局部变量的初始化检查
+static const char* ResolveCRLF(const char* begin, const char* end);
+static const char* ResolveChar(const char* begin, const char* end, char c);
+
+static std::atomic<FindCRLFFunc> findCRLF(ResolveCRLF);
+static std::atomic<FindCharFunc> findChar(ResolveChar);
+static std::atomic<const char*> implName("scalar");
+
+static void Resolve(){
+    if(HasAVX2())
+    {
+        findCRLF.store(HttpScan::FindCRLFAVX2, std::memory_order_relaxed);
+        findChar.store(HttpScan::FindCharAVX2, std::memory_order_relaxed);
+        implName.store("avx2", std::memory_order_relaxed);
+    }
+    else if(HasSSE2())
+    {
+        findCRLF.store(HttpScan::FindCRLFSSE2, std::memory_order_relaxed);
+        findChar.store(HttpScan::FindCharSSE2, std::memory_order_relaxed);
+        implName.store("sse2", std::memory_order_relaxed);
+    }
+    else
+    {
+        findCRLF.store(HttpScan::FindCRLFScalar, std::memory_order_relaxed);
+        findChar.store(HttpScan::FindCharScalar, std::memory_order_relaxed);
+    }
+}
+
+static const char* ResolveCRLF(const char* begin, const char* end){
+    Resolve();
+    return findCRLF.load(std::memory_order_relaxed)(begin, end);
+}
+
+static const char* ResolveChar(const char* begin, const char* end, char c){
+    Resolve();
+    return findChar.load(std::memory_order_relaxed)(begin, end, c);
+}
+
+const char* HttpScan::FindCRLF(const char* begin, const char* end){
+    return findCRLF.load(std::memory_order_relaxed)(begin, end);
+}
+
+const char* HttpScan::FindChar(const char* begin, const char* end, char c){
+    return findChar.load(std::memory_order_relaxed)(begin, end, c);
+}
+
+const char* HttpScan::ImplName(){
+    if(findCRLF.load(std::memory_order_relaxed) == ResolveCRLF)
+    {
+        Resolve();
+    }
+    return implName.load(std::memory_order_relaxed);
+}
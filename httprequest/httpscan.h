@@ -0,0 +1,25 @@
+#ifndef HTTPSCAN_H
+#define HTTPSCAN_H
+
+#include <cstddef>
+
+// HTTP报文扫描：找行尾"\r\n"和分隔符（':'、' '等）
+// x86上用SSE2/AVX2一次比较16/32字节，启动时按CPU能力选一次实现，其他平台走逐字节版本
+// 所有函数都只读[begin, end)，找不到时返回end
+class HttpScan {
+public:
+       static const char* FindCRLF(const char* begin, const char* end);        // 返回"\r\n"中'\r'的位置
+       static const char* FindChar(const char* begin, const char* end, char c);
+
+       static const char* ImplName(); // 当前选中的实现："avx2"、"sse2"或"scalar"
+
+       // 各实现单独暴露出来，方便基准测试对比；不支持的实现退化为scalar
+       static const char* FindCRLFScalar(const char* begin, const char* end);
+       static const char* FindCRLFSSE2(const char* begin, const char* end);
+       static const char* FindCRLFAVX2(const char* begin, const char* end);
+       static const char* FindCharScalar(const char* begin, const char* end, char c);
+       static const char* FindCharSSE2(const char* begin, const char* end, char c);
+       static const char* FindCharAVX2(const char* begin, const char* end, char c);
+};
+
+#endif
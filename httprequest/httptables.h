@@ -0,0 +1,186 @@
+#ifndef HTTPTABLES_H
+#define HTTPTABLES_H
+
+#include <cstring>
+#include <strings.h>
+#include "strview.h"
+
+// 请求解析热路径上的静态查表：HTTP方法、常用请求头、默认路由
+// 全部是编译期写死的switch：先按长度分支，再按一两个字符区分，最后memcmp确认，
+// 每个分支最多只剩一个候选（等价于完美哈希），不申请内存，也不对字符串做运行时哈希
+
+enum HttpMethod {
+    METHOD_UNKNOWN,
+    METHOD_GET,
+    METHOD_HEAD,
+    METHOD_POST,
+    METHOD_PUT,
+    METHOD_DELETE,
+    METHOD_OPTIONS,
+    METHOD_PATCH,
+    METHOD_CONNECT,
+    METHOD_TRACE,
+};
+
+// 常用请求头，解析时直接记下位置，按ID取值是O(1)
+enum HttpHeader {
+    HEADER_UNKNOWN = -1,
+    HEADER_HOST,
+    HEADER_CONNECTION,
+    HEADER_KEEP_ALIVE,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_EXPECT,
+    HEADER_COOKIE,
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_ACCEPT_LANGUAGE,
+    HEADER_USER_AGENT,
+    HEADER_REFERER,
+    HEADER_RANGE,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_CACHE_CONTROL,
+    HEADER_UPGRADE,
+    HEADER_COUNT,
+};
+
+class HttpTables {
+public:
+    // 方法名大小写敏感（RFC 7230 3.1.1）
+    static HttpMethod LookupMethod(const char* s, size_t len) {
+        switch(len)
+        {
+            case 3:
+                if(memcmp(s, "GET", 3) == 0) return METHOD_GET;
+                if(memcmp(s, "PUT", 3) == 0) return METHOD_PUT;
+                break;
+            case 4:
+                if(s[0] == 'P' && memcmp(s, "POST", 4) == 0) return METHOD_POST;
+                if(s[0] == 'H' && memcmp(s, "HEAD", 4) == 0) return METHOD_HEAD;
+                break;
+            case 5:
+                if(s[0] == 'P' && memcmp(s, "PATCH", 5) == 0) return METHOD_PATCH;
+                if(s[0] == 'T' && memcmp(s, "TRACE", 5) == 0) return METHOD_TRACE;
+                break;
+            case 6:
+                if(memcmp(s, "DELETE", 6) == 0) return METHOD_DELETE;
+                break;
+            case 7:
+                if(s[0] == 'O' && memcmp(s, "OPTIONS", 7) == 0) return METHOD_OPTIONS;
+                if(s[0] == 'C' && memcmp(s, "CONNECT", 7) == 0) return METHOD_CONNECT;
+                break;
+            default:
+                break;
+        }
+        return METHOD_UNKNOWN;
+    }
+
+    static const char* MethodName(HttpMethod method) {
+        static const char* const names[] = {
+            "", "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH", "CONNECT", "TRACE",
+        };
+        return names[method];
+    }
+
+    // 字段名大小写不敏感，先按长度和首字母（转小写）分支
+    static HttpHeader LookupHeader(const char* s, size_t len) {
+#define HTTPTABLES_MATCH(name, id) \
+            if(strncasecmp(s, name, len) == 0) return id;
+        if(len == 0)
+        {
+            return HEADER_UNKNOWN;
+        }
+        char c = static_cast<char>(s[0] | 0x20);
+        switch(len)
+        {
+            case 4:
+                if(c == 'h') HTTPTABLES_MATCH("host", HEADER_HOST)
+                break;
+            case 5:
+                if(c == 'r') HTTPTABLES_MATCH("range", HEADER_RANGE)
+                break;
+            case 6:
+                if(c == 'c') HTTPTABLES_MATCH("cookie", HEADER_COOKIE)
+                if(c == 'a') HTTPTABLES_MATCH("accept", HEADER_ACCEPT)
+                if(c == 'e') HTTPTABLES_MATCH("expect", HEADER_EXPECT)
+                break;
+            case 7:
+                if(c == 'r') HTTPTABLES_MATCH("referer", HEADER_REFERER)
+                if(c == 'u') HTTPTABLES_MATCH("upgrade", HEADER_UPGRADE)
+                break;
+            case 10:
+                if(c == 'c') HTTPTABLES_MATCH("connection", HEADER_CONNECTION)
+                if(c == 'k') HTTPTABLES_MATCH("keep-alive", HEADER_KEEP_ALIVE)
+                if(c == 'u') HTTPTABLES_MATCH("user-agent", HEADER_USER_AGENT)
+                break;
+            case 12:
+                if(c == 'c') HTTPTABLES_MATCH("content-type", HEADER_CONTENT_TYPE)
+                break;
+            case 13:
+                if(c == 'c') HTTPTABLES_MATCH("cache-control", HEADER_CACHE_CONTROL)
+                break;
+            case 14:
+                if(c == 'c') HTTPTABLES_MATCH("content-length", HEADER_CONTENT_LENGTH)
+                break;
+            case 15:
+                if(c == 'a' && (s[7] | 0x20) == 'e') HTTPTABLES_MATCH("accept-encoding", HEADER_ACCEPT_ENCODING)
+                if(c == 'a' && (s[7] | 0x20) == 'l') HTTPTABLES_MATCH("accept-language", HEADER_ACCEPT_LANGUAGE)
+                break;
+            case 17:
+                if(c == 't') HTTPTABLES_MATCH("transfer-encoding", HEADER_TRANSFER_ENCODING)
+                if(c == 'i') HTTPTABLES_MATCH("if-modified-since", HEADER_IF_MODIFIED_SINCE)
+                break;
+            default:
+                break;
+        }
+#undef HTTPTABLES_MATCH
+        return HEADER_UNKNOWN;
+    }
+
+    // 默认页面：不带后缀的路径补上".html"，返回改写后的路径，不是默认页面时返回nullptr
+    // 原来的DEFAULT_HTML："/index" "/register" "/login" "/welcome" "/viedo" "/picture"
+    static const char* LookupDefaultHtml(StrView path) {
+        if(path.size < 2 || path.data[0] != '/')
+        {
+            return nullptr;
+        }
+        switch(path.size)
+        {
+            case 6:
+                if(path.data[1] == 'i' && path.Equals("/index", 6)) return "/index.html";
+                if(path.data[1] == 'l' && path.Equals("/login", 6)) return "/login.html";
+                if(path.data[1] == 'v' && path.Equals("/viedo", 6)) return "/viedo.html";
+                break;
+            case 8:
+                if(path.Equals("/welcome", 8)) return "/welcome.html";
+                if(path.Equals("/picture", 8)) return "/picture.html";
+                break;
+            case 9:
+                if(path.Equals("/register", 9)) return "/register.html";
+                break;
+            default:
+                break;
+        }
+        return nullptr;
+    }
+
+    // 需要做用户验证的页面（原来的DEFAULT_HTML_TAG）：注册页为0，登录页为1，其余返回-1
+    static int LookupHtmlTag(StrView path) {
+        switch(path.size)
+        {
+            case 11:
+                if(path.Equals("/login.html", 11)) return 1;
+                break;
+            case 14:
+                if(path.Equals("/register.html", 14)) return 0;
+                break;
+            default:
+                break;
+        }
+        return -1;
+    }
+
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// SHA-256（FIPS 180-4），项目里不想为了摘要再链接OpenSSL
+class Sha256 {
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Sha256() { Reset(); }
+
+    void Reset();
+    void Update(const void* data, size_t len);
+    void Final(uint8_t out[DIGEST_SIZE]);//之后要重新Reset才能再用
+
+    static void Hash(const void* data, size_t len, uint8_t out[DIGEST_SIZE]);
+
+private:
+    void Transform_(const uint8_t block[64]);
+
+    uint32_t state_[8];
+    uint64_t bits_;//已经输入的总位数
+    uint8_t block_[64];
+    size_t used_;//block_中已有的字节数
+};
+
+#endif
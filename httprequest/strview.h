@@ -0,0 +1,35 @@
+#ifndef STRVIEW_H
+#define STRVIEW_H
+
+#include <string>
+#include <cstring>
+#include <strings.h>
+
+// 只读字符串视图（项目用C++11，没有std::string_view）
+// 不拥有内存，指向的数据必须比视图活得久
+struct StrView {
+    const char* data;
+    size_t size;
+
+    StrView() : data(""), size(0) {}
+    StrView(const char* d, size_t n) : data(d), size(n) {}
+    StrView(const char* begin, const char* end) : data(begin), size(end - begin) {}
+    explicit StrView(const std::string& str) : data(str.data()), size(str.size()) {}
+
+    bool empty() const { return size == 0; }
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+    std::string ToString() const { return std::string(data, size); }
+
+    bool Equals(const char* str, size_t len) const {
+        return size == len && memcmp(data, str, len) == 0;
+    }
+    bool Equals(const char* str) const { return Equals(str, strlen(str)); }
+    bool Equals(const std::string& str) const { return Equals(str.data(), str.size()); }
+    bool EqualsIgnoreCase(const char* str, size_t len) const {
+        return size == len && strncasecmp(data, str, len) == 0;
+    }
+    bool EqualsIgnoreCase(const char* str) const { return EqualsIgnoreCase(str, strlen(str)); }
+};
+
+#endif
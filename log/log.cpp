@@ -12,11 +12,13 @@ Log::Log(){
 
 //析构函数
 Log::~Log(){
-    while(!deque_->empty()){
-        deque_->flush();//唤醒消费者,处理掉剩下的任务
+    if(deque_){ //没有init过或者一直是同步日志时没有队列和写线程
+        while(!deque_->empty()){
+            deque_->flush();//唤醒消费者,处理掉剩下的任务
+        }
+        deque_->close();//关闭队列
+        writeThread_->join();//等待当前线程完成手中的任务
     }
-    deque_->close();//关闭队列
-    writeThread_->join();//等待当前线程完成手中的任务
     if(fp_){
         flush();//清空缓冲区的数据
         fclose(fp_);//关闭文件
@@ -40,20 +42,39 @@ Log* Log::Instance(){
 
 //异步日志的写线程函数
 void Log::FlushLogThread(){
-    Log::Instance()->asyncWrite();
+    Log* log = Log::Instance();
+    Placement::Bind(log->writerCpus_);//先绑核，写线程的缓冲区就分配在本节点
+    {
+        lock_guard<mutex> locker(log->mutex_);
+        log->writerAffinity_ = Placement::FormatCpuList(Placement::CurrentAffinity());
+    }
+    log->asyncWrite();
+}
+
+string Log::WriterAffinity(){
+    lock_guard<mutex> locker(mutex_);
+    return writerAffinity_;
 }
 
 //写线程真正的执行函数
+//一次从队列里取走现有的一批（最多WRITE_BATCH条），拼起来用一次fwrite写入，每批只加一次锁
 void Log::asyncWrite(){
-    string str = "";
-    while(deque_->pop(str)){
+    vector<string> lines;
+    string chunk;
+    lines.reserve(WRITE_BATCH);
+    while(deque_->pop_bulk(lines, WRITE_BATCH)){
+        chunk.clear();
+        for(const string& line : lines){
+            chunk.append(line.c_str());//每条末尾带着'\0'，和原来fputs一样写到'\0'为止
+        }
+        lines.clear();
         lock_guard<mutex> locker(mutex_);//加锁
-        fputs(str.c_str(), fp_);//将字符串写入文件
+        fwrite(chunk.data(), 1, chunk.size(), fp_);//将这一批写入文件
     }
 }
 
 //初始化日志实例
-void Log::init(int level, const char* path, const char* suffix, int maxQueueSize){
+void Log::init(int level, const char* path, const char* suffix, int maxQueueSize, const Placement& placement){
     isOpen_ = true;
     level_ = level;
     path_ = path;
@@ -61,10 +82,11 @@ void Log::init(int level, const char* path, const char* suffix, int maxQueueSize
     if(maxQueueSize){  //如果队列大小不为0，说明是异步日志
         isAsync_ = true;
         if(!deque_){ //如果队列为空，说明是第一次调用
-            unique_ptr<BlockQueue<string>> newDeque(new BlockQueue<string>(maxQueueSize));
+            unique_ptr<Queue> newDeque(new Queue(maxQueueSize));
             // 因为unique_ptr不支持普通的拷贝或赋值操作,所以采用move
             // 将动态申请的内存权给deque，newDeque被释放
             deque_ = move(newDeque);//将新的阻塞队列赋值给deque_
+            writerCpus_ = placement.CpusFor(0, 0);
             unique_ptr<thread> newThread(new thread(FlushLogThread));
             writeThread_ = move(newThread);
         }
@@ -3,6 +3,7 @@
 
 #include <mutex>
 #include <string>
+#include <vector>
 #include <thread>
 #include <sys/time.h>
 #include <string.h>
@@ -11,12 +12,21 @@
 #include <sys/stat.h>         
 // #include "blockqueue.h"
 #include "../buffer/blockqueue.h"
+#include "../buffer/lockfreequeue.h"
 #include "../buffer/buffer.h"
+#include "../poll/placement.h"
+
+//异步日志用的队列模板，编译时用-DLOG_QUEUE=LockFreeQueue换成无锁队列，两者接口一样
+#ifndef LOG_QUEUE
+#define LOG_QUEUE BlockQueue
+#endif
 
 class Log{
 public: 
         //初始化日志实例（阻塞队列最大容量、日志保存路径、日志文件后缀）
-        void init(int level, const char* path="./log",const char* suffix=".log",int maxQueueSize=1024);
+        //placement决定异步写线程绑到哪些核上，用它第一个域的第一个位置；只在第一次创建写线程时生效
+        void init(int level, const char* path="./log",const char* suffix=".log",int maxQueueSize=1024,
+                  const Placement& placement = Placement());
 
         static Log* Instance();
         static void FlushLogThread();//异步写日志公有方法，调用私有方法asyncWrite
@@ -27,6 +37,7 @@ public:
         int getLevel();//获取日志等级
         void setLevel(int level);//设置日志等级
         bool isOpen(){return isOpen_;}//判断日志文件是否打开
+        std::string WriterAffinity();//写线程绑核后读回来的亲和性，比如"0-3"；没有写线程时为空
 
 private:
         Log();
@@ -39,6 +50,7 @@ private:
         static const int LOG_PATH_LEN = 256;//日志路径长度
         static const int LOG_NAME_LEN = 256;//日志名称长度
         static const int MAX_LINES = 50000;//最大行数
+        static const int WRITE_BATCH = 256;//写线程一次最多从队列取的日志条数
 
         const char* path_; //日志路径
         const char* suffix_; //日志后缀
@@ -55,8 +67,11 @@ private:
         bool isAsync_; //是否开启异步日志
 
         FILE* fp_; //打开log的文件指针
-        std::unique_ptr<BlockQueue<std::string>> deque_; //阻塞队列
+        typedef LOG_QUEUE<std::string> Queue;
+        std::unique_ptr<Queue> deque_; //阻塞队列
         std::unique_ptr<std::thread> writeThread_; //写线程的指针
+        std::vector<int> writerCpus_; //写线程要绑的核，空表示不绑
+        std::string writerAffinity_; //由mutex_保护
         std::mutex mutex_; //互斥锁
 };
 
@@ -0,0 +1,144 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <stdint.h>
+
+// 对数-线性直方图（和HdrHistogram一个思路）：每个2的幂区间再等分成SUB个桶，相对误差不超过1/SUB
+// 值小于SUB时一个值一个桶；最大记到2^(MAX_EXP+1)-1，再大的算进最后一个桶
+// 单写者：Add只能由一个线程调用（比如工作线程记自己的），用普通的读加写而不是原子加，不锁总线；
+// 别的线程随时可以读或者拷贝出一份快照，读到的每个桶都是完整的值，只是各个桶之间不是同一时刻的
+class LogHistogram {
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB = 1 << SUB_BITS;
+    static const int MAX_EXP = 40;//以纳秒计大约18分钟
+    static const int BUCKETS = SUB + (MAX_EXP - SUB_BITS + 1) * SUB;
+
+    LogHistogram() {
+        Clear();
+    }
+
+    LogHistogram(const LogHistogram& other) {
+        *this = other;
+    }
+
+    LogHistogram& operator=(const LogHistogram& other) {
+        for(int i = 0; i < BUCKETS; i++)
+        {
+            buckets_[i].store(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        count_.store(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sum_.store(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        max_.store(other.max_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    static int BucketOf(uint64_t value) {
+        if(value < static_cast<uint64_t>(SUB))
+        {
+            return static_cast<int>(value);
+        }
+        int exp = 63 - __builtin_clzll(value);
+        if(exp > MAX_EXP)
+        {
+            return BUCKETS - 1;
+        }
+        int sub = static_cast<int>(value >> (exp - SUB_BITS)) & (SUB - 1);//最高位下面的SUB_BITS位
+        return SUB + (exp - SUB_BITS) * SUB + sub;
+    }
+
+    //桶里最小的值
+    static uint64_t LowerBound(int bucket) {
+        if(bucket < SUB)
+        {
+            return bucket;
+        }
+        int exp = (bucket - SUB) / SUB + SUB_BITS;
+        uint64_t sub = (bucket - SUB) % SUB;
+        return (SUB + sub) << (exp - SUB_BITS);
+    }
+
+    //单写者
+    void Add(uint64_t value) {
+        Bump_(buckets_[BucketOf(value)], 1);
+        Bump_(count_, 1);
+        Bump_(sum_, value);
+        if(value > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    //把other加进来，也只能由这一份的写者调用
+    void Merge(const LogHistogram& other) {
+        for(int i = 0; i < BUCKETS; i++)
+        {
+            Bump_(buckets_[i], other.buckets_[i].load(std::memory_order_relaxed));
+        }
+        Bump_(count_, other.count_.load(std::memory_order_relaxed));
+        Bump_(sum_, other.sum_.load(std::memory_order_relaxed));
+        uint64_t max = other.max_.load(std::memory_order_relaxed);
+        if(max > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(max, std::memory_order_relaxed);
+        }
+    }
+
+    void Clear() {
+        for(int i = 0; i < BUCKETS; i++)
+        {
+            buckets_[i].store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t Bucket(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+    uint64_t Mean() const {
+        uint64_t count = Count();
+        return count ? sum_.load(std::memory_order_relaxed) / count : 0;
+    }
+
+    //q取0~1，返回所在桶的中间值，不超过记到的最大值
+    uint64_t Percentile(double q) const {
+        uint64_t count = Count();
+        if(count == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * count);
+        if(rank >= count)
+        {
+            rank = count - 1;
+        }
+        uint64_t seen = 0;
+        for(int i = 0; i < BUCKETS; i++)
+        {
+            seen += Bucket(i);
+            if(seen > rank)
+            {
+                uint64_t low = LowerBound(i);
+                uint64_t mid = i + 1 < BUCKETS ? low + (LowerBound(i + 1) - low) / 2 : low;
+                return mid < Max() ? mid : Max();
+            }
+        }
+        return Max();
+    }
+
+private:
+    static void Bump_(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+#endif
@@ -0,0 +1,355 @@
+#include "placement.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+//读一个/sys或/proc下的小文件，去掉末尾换行
+static std::string ReadLine(const std::string& path){
+    FILE* fp = fopen(path.c_str(), "r");
+    if(!fp)
+    {
+        return "";
+    }
+    char line[4096] = {0};
+    if(!fgets(line, sizeof(line), fp))
+    {
+        line[0] = '\0';
+    }
+    fclose(fp);
+    std::string text(line);
+    while(!text.empty() && isspace(static_cast<unsigned char>(text.back())))
+    {
+        text.pop_back();
+    }
+    return text;
+}
+
+// 机器拓扑，只在第一次用到时读一遍
+struct Topology {
+    std::vector<int> nodeOfCpu;//核号 -> 节点号
+    std::vector<std::pair<int, std::vector<int>>> nodes;//节点号和它的核，按节点号排好
+};
+
+static const Topology& Topo(){
+    static const Topology topo = []() {
+        Topology t;
+        std::vector<int> online = Placement::ParseCpuList(ReadLine("/sys/devices/system/cpu/online"));
+        if(online.empty())
+        {
+            online = Placement::CurrentAffinity();
+        }
+        DIR* dir = opendir("/sys/devices/system/node");
+        if(dir)
+        {
+            struct dirent* entry;
+            while((entry = readdir(dir)) != nullptr)
+            {
+                int node;
+                char tail;
+                if(sscanf(entry->d_name, "node%d%c", &node, &tail) != 1)
+                {
+                    continue;
+                }
+                std::vector<int> cpus = Placement::ParseCpuList(
+                    ReadLine(std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist"));
+                if(!cpus.empty())
+                {
+                    t.nodes.push_back(std::make_pair(node, cpus));
+                }
+            }
+            closedir(dir);
+        }
+        if(t.nodes.empty())//内核没开NUMA，当成一个节点
+        {
+            t.nodes.push_back(std::make_pair(0, online));
+        }
+        std::sort(t.nodes.begin(), t.nodes.end());
+        for(const auto& node : t.nodes)
+        {
+            for(int cpu : node.second)
+            {
+                if(cpu >= static_cast<int>(t.nodeOfCpu.size()))
+                {
+                    t.nodeOfCpu.resize(cpu + 1, -1);
+                }
+                t.nodeOfCpu[cpu] = node.first;
+            }
+        }
+        return t;
+    }();
+    return topo;
+}
+
+Placement::Placement() : pinSingle_(false){
+    Domain domain;
+    domain.node = -1;
+    domains_.push_back(domain);
+}
+
+Placement Placement::Cpus(const std::vector<int>& cpus){
+    Placement placement;
+    if(!cpus.empty())
+    {
+        placement.AddCpus_(cpus);
+        placement.pinSingle_ = true;
+    }
+    return placement;
+}
+
+Placement Placement::SpreadNuma(){
+    Placement placement;
+    const Topology& topo = Topo();
+    if(topo.nodes.size() > 1)
+    {
+        for(const auto& node : topo.nodes)
+        {
+            placement.AddCpus_(node.second);
+        }
+    }
+    return placement;
+}
+
+Placement Placement::NearNic(const std::string& ifname){
+    Placement placement;
+    if(ifname.empty())
+    {
+        return placement;
+    }
+    //每个收发队列一个中断，名字像"eth0-TxRx-3"、"mlx5_comp3@pci:..."里不一定带网卡名，所以只认带网卡名的
+    std::vector<int> queueCpus;
+    FILE* fp = fopen("/proc/interrupts", "r");
+    if(fp)
+    {
+        char line[4096];
+        while(fgets(line, sizeof(line), fp))
+        {
+            char* end = nullptr;
+            long irq = strtol(line, &end, 10);
+            if(end == line || *end != ':')
+            {
+                continue;
+            }
+            const char* found = strstr(end, ifname.c_str());
+            if(!found || isalnum(static_cast<unsigned char>(found[ifname.size()])))//eth1不能匹配到eth10
+            {
+                continue;
+            }
+            std::vector<int> cpus = ParseCpuList(ReadLine("/proc/irq/" + std::to_string(irq) + "/smp_affinity_list"));
+            queueCpus.insert(queueCpus.end(), cpus.begin(), cpus.end());
+        }
+        fclose(fp);
+    }
+    if(!queueCpus.empty())
+    {
+        placement.AddCpus_(queueCpus);
+        placement.pinSingle_ = true;
+        return placement;
+    }
+    std::vector<int> local = ParseCpuList(ReadLine("/sys/class/net/" + ifname + "/device/local_cpulist"));
+    if(!local.empty())
+    {
+        placement.AddCpus_(local);
+    }
+    return placement;
+}
+
+void Placement::AddCpus_(const std::vector<int>& cpus){
+    if(domains_.size() == 1 && domains_[0].cpus.empty())//去掉默认的不绑核的域
+    {
+        domains_.clear();
+    }
+    std::vector<int> sorted(cpus);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    for(int cpu : sorted)
+    {
+        if(cpu < 0)
+        {
+            continue;
+        }
+        if(cpu >= static_cast<int>(domainOfCpu_.size()))
+        {
+            domainOfCpu_.resize(cpu + 1, -1);
+        }
+        if(domainOfCpu_[cpu] >= 0)
+        {
+            continue;
+        }
+        int node = NodeOfCpu(cpu);
+        size_t i = 0;
+        while(i < domains_.size() && domains_[i].node != node)
+        {
+            i++;
+        }
+        if(i == domains_.size())
+        {
+            Domain domain;
+            domain.node = node;
+            domains_.push_back(domain);
+        }
+        domains_[i].cpus.push_back(cpu);
+        domainOfCpu_[cpu] = static_cast<int>(i);
+    }
+    if(domains_.empty())
+    {
+        *this = Placement();
+    }
+}
+
+std::vector<int> Placement::CpusFor(size_t domain, size_t k) const{
+    const std::vector<int>& cpus = domains_[domain].cpus;
+    if(cpus.empty() || !pinSingle_)
+    {
+        return cpus;
+    }
+    return std::vector<int>(1, cpus[k % cpus.size()]);
+}
+
+int Placement::DomainOfCurrentCpu() const{
+    if(domains_.size() == 1)
+    {
+        return 0;
+    }
+    int cpu = sched_getcpu();
+    if(cpu < 0 || cpu >= static_cast<int>(domainOfCpu_.size()))
+    {
+        return -1;
+    }
+    return domainOfCpu_[cpu];
+}
+
+std::string Placement::Describe() const{
+    std::string text;
+    for(const Domain& domain : domains_)
+    {
+        if(!text.empty())
+        {
+            text += ' ';
+        }
+        text += domain.node >= 0 ? "node" + std::to_string(domain.node) : std::string("any");
+        text += ':';
+        text += domain.cpus.empty() ? std::string("*") : FormatCpuList(domain.cpus);
+    }
+    if(pinSingle_)
+    {
+        text += " (one cpu per thread)";
+    }
+    return text;
+}
+
+bool Placement::Bind(const std::vector<int>& cpus){
+    if(cpus.empty())
+    {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus)
+    {
+        if(cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::vector<int> Placement::CurrentAffinity(){
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        return cpus;
+    }
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if(CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int Placement::NodeOfCpu(int cpu){
+    const Topology& topo = Topo();
+    if(cpu < 0 || cpu >= static_cast<int>(topo.nodeOfCpu.size()))
+    {
+        return -1;
+    }
+    return topo.nodeOfCpu[cpu];
+}
+
+std::vector<int> Placement::ParseCpuList(const std::string& text){
+    std::vector<int> cpus;
+    const char* p = text.c_str();
+    while(*p)
+    {
+        char* end = nullptr;
+        long first = strtol(p, &end, 10);
+        if(end == p)
+        {
+            break;
+        }
+        long last = first;
+        p = end;
+        if(*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        while(*p == ',' || isspace(static_cast<unsigned char>(*p)))
+        {
+            p++;
+        }
+    }
+    return cpus;
+}
+
+std::string Placement::FormatCpuList(const std::vector<int>& cpus){
+    std::string text;
+    for(size_t i = 0; i < cpus.size(); )
+    {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+        {
+            j++;
+        }
+        if(!text.empty())
+        {
+            text += ',';
+        }
+        text += std::to_string(cpus[i]);
+        if(j > i)
+        {
+            text += '-' + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text;
+}
+
+Placement::ScopedBind::ScopedBind(const std::vector<int>& cpus) : bound_(false){
+    if(!cpus.empty())
+    {
+        saved_ = CurrentAffinity();
+        bound_ = Bind(cpus);
+    }
+}
+
+Placement::ScopedBind::~ScopedBind(){
+    if(bound_)
+    {
+        Bind(saved_);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// 线程放置策略：工作线程绑到哪些CPU上，按NUMA节点分成若干个域(Domain)
+// 线程池给每个域一个任务队列，域里的线程优先做本域的任务；拓扑从/sys读，不依赖libnuma
+// 机器只有一个节点、或者读不到拓扑时退化成一个域，效果和不绑核一样
+class Placement {
+public:
+    struct Domain {
+        int node;              //NUMA节点号，不知道时为-1
+        std::vector<int> cpus; //这个域的CPU，空表示不绑核
+    };
+
+    Placement();//不绑核，一个域
+
+    //只用cpus里的核，每个线程绑一个核，轮流分配；按核所在的NUMA节点分成多个域
+    static Placement Cpus(const std::vector<int>& cpus);
+    //每个NUMA节点一个域，线程轮流分到各节点，在节点内的核之间浮动
+    static Placement SpreadNuma();
+    //绑到网卡收发队列中断所在的核上（/proc/interrupts里名字带ifname的中断的smp_affinity_list），每个线程一个核；
+    //找不到中断时用网卡所在节点的核（/sys/class/net/<ifname>/device/local_cpulist），再找不到就不绑核
+    static Placement NearNic(const std::string& ifname);
+
+    size_t Domains() const { return domains_.size(); }
+    const Domain& DomainAt(size_t i) const { return domains_[i]; }
+    //域里第k个线程该绑的核：PinSingle时是一个核，否则是整个域
+    std::vector<int> CpusFor(size_t domain, size_t k) const;
+    //当前线程在哪个域：按所在的核找，找不到返回-1
+    int DomainOfCurrentCpu() const;
+    std::string Describe() const;//比如"node0:0-3,8-11 node1:4-7"，用来打日志
+
+    //把当前线程绑到cpus上，cpus为空时什么也不做
+    static bool Bind(const std::vector<int>& cpus);
+    static std::vector<int> CurrentAffinity();
+    static int NodeOfCpu(int cpu);//-1表示不知道
+    static std::vector<int> ParseCpuList(const std::string& text);//"0-3,8" -> {0,1,2,3,8}
+    static std::string FormatCpuList(const std::vector<int>& cpus);
+
+    // 在作用域内把当前线程临时绑到某个域的核上，析构时恢复原来的亲和性
+    // Linux默认按第一次写的线程所在节点分配物理页，所以在这里面分配并写过的内存落在那个节点上
+    class ScopedBind {
+    public:
+        explicit ScopedBind(const std::vector<int>& cpus);
+        ~ScopedBind();
+        ScopedBind(const ScopedBind&) = delete;
+        ScopedBind& operator=(const ScopedBind&) = delete;
+    private:
+        std::vector<int> saved_;
+        bool bound_;
+    };
+
+private:
+    void AddCpus_(const std::vector<int>& cpus);//按节点分组放进domains_
+
+    std::vector<Domain> domains_;
+    bool pinSingle_;
+    std::vector<int> domainOfCpu_;//核号 -> 域号，-1表示不在任何域里
+};
+
+#endif
@@ -0,0 +1,728 @@
+#include "sqlasync.h"
+#include <mysql/errmsg.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+
+SqlAsync::SqlAsync() : port_(0), next_(0), inFlight_(0), escaper_(nullptr) {}
+
+SqlAsync* SqlAsync::Instance(){
+    static SqlAsync async;
+    return &async;
+}
+
+static int SocketOf(MYSQL* mysql){
+    if(!mysql)
+    {
+        return -1;
+    }
+#ifdef SQLASYNC_MARIADB
+    return mysql_get_socket(mysql);
+#else
+    return mysql->net.fd;
+#endif
+}
+
+static MYSQL* NewHandle(){
+    MYSQL* mysql = mysql_init(nullptr);
+#ifdef SQLASYNC_MARIADB
+    if(mysql)
+    {
+        mysql_options(mysql, MYSQL_OPT_NONBLOCK, 0);
+    }
+#endif
+    return mysql;
+}
+
+static bool IsConnectionLost(int err){
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+bool SqlAsync::Init(const char* host, int port, const char* user, const char* passwd, const char* dbName,
+                    int connSize, int loopThreads){
+    assert(connSize > 0 && loopThreads > 0);
+    assert(loops_.empty());
+    if(loopThreads > connSize)
+    {
+        loopThreads = connSize;
+    }
+    host_ = host;
+    port_ = port;
+    user_ = user;
+    passwd_ = passwd;
+    dbName_ = dbName;
+    mysql_library_init(0, nullptr, nullptr);
+    escaper_ = mysql_init(nullptr);
+
+    for(int i = 0; i < loopThreads; i++)
+    {
+        std::unique_ptr<Loop> loop(new Loop);
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        loop->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(loop->epfd < 0 || loop->evfd < 0)
+        {
+            LOG_ERROR("SqlAsync epoll/eventfd error: %d", errno);
+            if(loop->epfd >= 0) close(loop->epfd);
+            if(loop->evfd >= 0) close(loop->evfd);
+            Close();
+            return false;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;//data.ptr为空的是eventfd
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->evfd, &ev);
+        loop->connected = 0;
+        loop->stop = false;
+        loop->busy = 0;
+        loop->closed = 0;
+        loops_.push_back(std::move(loop));
+    }
+    for(int i = 0; i < connSize; i++)
+    {
+        Loop* loop = loops_[i % loopThreads].get();
+        std::unique_ptr<Conn> conn(new Conn);
+        conn->loop = loop;
+        conn->mysql = NewHandle();
+        conn->fd = -1;
+        conn->stage = CONN_CLOSED;
+        conn->started = false;
+        conn->waitStatus = 0;
+        conn->op = nullptr;
+        conn->res = nullptr;
+        conn->retryAt = Clock::now();//循环线程起来后马上开始连
+        conn->backoffMs = 0;
+        loop->closed++;
+        loop->conns.push_back(std::move(conn));
+    }
+    for(auto& loop : loops_)
+    {
+        Loop* ptr = loop.get();
+        loop->thread = std::thread([this, ptr]{ Run_(ptr); });
+    }
+    LOG_INFO("SqlAsync init: %d connections on %d loops", connSize, loopThreads);
+    return true;
+}
+
+void SqlAsync::Close(){
+    std::vector<std::unique_ptr<Loop>> loops;
+    {
+        //拿走之后新的Query看到的是空的，直接以错误结束；已经放进incoming的由循环退出时处理
+        std::lock_guard<std::mutex> locker(loopsMtx_);
+        loops.swap(loops_);
+    }
+    for(auto& loop : loops)
+    {
+        loop->stop = true;
+        uint64_t one = 1;
+        ssize_t n = write(loop->evfd, &one, sizeof(one));
+        (void)n;
+    }
+    for(auto& loop : loops)
+    {
+        if(loop->thread.joinable())
+        {
+            loop->thread.join();
+        }
+        close(loop->epfd);
+        close(loop->evfd);
+    }
+    if(escaper_)
+    {
+        mysql_close(escaper_);
+        escaper_ = nullptr;
+    }
+}
+
+void SqlAsync::Query(std::string sql, Callback cb){
+    Op* op = new Op;
+    op->sql = std::move(sql);
+    op->cb = std::move(cb);
+    {
+        //和Close互斥：放进incoming和写eventfd时循环一定还在，不会漏掉回调，也不会写到已经关掉的fd
+        std::lock_guard<std::mutex> closeLocker(loopsMtx_);
+        if(!loops_.empty())
+        {
+            inFlight_.fetch_add(1, std::memory_order_relaxed);
+            Loop* loop = loops_[next_.fetch_add(1, std::memory_order_relaxed) % loops_.size()].get();
+            bool wake;
+            {
+                std::lock_guard<std::mutex> locker(loop->mtx);
+                wake = loop->incoming.empty();//队列原来不空说明已经唤醒过，循环还没取走
+                loop->incoming.push_back(op);
+            }
+            if(wake)
+            {
+                uint64_t one = 1;
+                ssize_t n = write(loop->evfd, &one, sizeof(one));
+                (void)n;
+            }
+            return;
+        }
+    }
+    op->result.err = -1;
+    op->result.error = "SqlAsync not initialized";
+    op->cb(op->result);
+    delete op;
+}
+
+std::future<SqlResult> SqlAsync::Query(std::string sql){
+    std::shared_ptr<std::promise<SqlResult>> promise = std::make_shared<std::promise<SqlResult>>();
+    std::future<SqlResult> future = promise->get_future();
+    Query(std::move(sql), [promise](SqlResult& result){ promise->set_value(std::move(result)); });
+    return future;
+}
+
+std::string SqlAsync::Escape(const std::string& str){
+    std::string out(str.size() * 2 + 1, '\0');
+    unsigned long len;
+    {
+        std::lock_guard<std::mutex> locker(escMtx_);
+        assert(escaper_);
+        len = mysql_real_escape_string(escaper_, &out[0], str.data(), str.size());
+    }
+    out.resize(len);
+    return out;
+}
+
+int SqlAsync::Connected(){
+    std::lock_guard<std::mutex> locker(loopsMtx_);
+    int total = 0;
+    for(auto& loop : loops_)
+    {
+        total += loop->connected.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void SqlAsync::SetStage_(Conn* conn, int stage){
+    Loop* loop = conn->loop;
+    int old = conn->stage;
+    if(old == stage)
+    {
+        return;
+    }
+    bool wasBusy = old == CONN_CONNECTING || old == CONN_QUERY || old == CONN_STORE;
+    bool isBusy = stage == CONN_CONNECTING || stage == CONN_QUERY || stage == CONN_STORE;
+    loop->busy += int(isBusy) - int(wasBusy);
+    loop->closed += int(stage == CONN_CLOSED) - int(old == CONN_CLOSED);
+    bool wasUp = old == CONN_IDLE || old == CONN_QUERY || old == CONN_STORE;
+    bool isUp = stage == CONN_IDLE || stage == CONN_QUERY || stage == CONN_STORE;
+    if(isUp != wasUp)
+    {
+        loop->connected.fetch_add(isUp ? 1 : -1, std::memory_order_relaxed);
+    }
+    conn->stage = stage;
+    conn->started = false;
+}
+
+//MySQL的*_nonblocking不告诉要等读还是等写，socket按边沿触发同时关注读写，一直挂着不用改
+//（水平触发时EPOLLOUT几乎一直就绪会空转），返回等待之前由Redrive_确认socket里没有剩下的数据；
+//MariaDB的*_start/*_cont返回要等的事件，按水平触发每次改成它要的
+void SqlAsync::Watch_(Conn* conn){
+    int fd = SocketOf(conn->mysql);
+    uint32_t events;
+#ifdef SQLASYNC_MARIADB
+    if(conn->stage == CONN_IDLE)
+    {
+        events = EPOLLIN | EPOLLRDHUP;
+    }
+    else
+    {
+        events = 0;
+        if(conn->waitStatus & MYSQL_WAIT_READ) events |= EPOLLIN;
+        if(conn->waitStatus & MYSQL_WAIT_WRITE) events |= EPOLLOUT;
+        if(conn->waitStatus & MYSQL_WAIT_EXCEPT) events |= EPOLLPRI;
+    }
+#else
+    events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+#endif
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.ptr = conn;
+    if(fd != conn->fd)
+    {
+        if(conn->fd >= 0)
+        {
+            epoll_ctl(conn->loop->epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        }
+        conn->fd = fd;
+        if(fd >= 0)
+        {
+            epoll_ctl(conn->loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        return;
+    }
+#ifdef SQLASYNC_MARIADB
+    if(fd >= 0)
+    {
+        epoll_ctl(conn->loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+#endif
+}
+
+#ifdef SQLASYNC_MARIADB
+//epoll事件换成MariaDB的等待状态；没有事件时只在超时到了才继续，返回0表示还不用调_cont
+static int ContStatus(int waitStatus, uint32_t events, std::chrono::steady_clock::time_point deadline){
+    int status = 0;
+    if(events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) status |= MYSQL_WAIT_READ;
+    if(events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) status |= MYSQL_WAIT_WRITE;
+    if(events & EPOLLPRI) status |= MYSQL_WAIT_EXCEPT;
+    status &= waitStatus;
+    if(!status && (waitStatus & MYSQL_WAIT_TIMEOUT) && std::chrono::steady_clock::now() >= deadline)
+    {
+        status = MYSQL_WAIT_TIMEOUT;
+    }
+    return status;
+}
+
+static std::chrono::steady_clock::time_point Deadline(MYSQL* mysql, int status){
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(status & MYSQL_WAIT_TIMEOUT)
+    {
+        return now + std::chrono::milliseconds(mysql_get_timeout_value_ms(mysql));
+    }
+    return now;
+}
+#endif
+
+SqlAsync::StepResult SqlAsync::StepConnect_(Conn* conn, uint32_t events){
+#ifdef SQLASYNC_MARIADB
+    MYSQL* ret = nullptr;
+    int status;
+    if(!conn->started)
+    {
+        conn->started = true;
+        status = mysql_real_connect_start(&ret, conn->mysql, host_.c_str(), user_.c_str(), passwd_.c_str(),
+                                          dbName_.c_str(), port_, nullptr, 0);
+    }
+    else
+    {
+        int ready = ContStatus(conn->waitStatus, events, conn->deadline);
+        if(!ready)
+        {
+            return STEP_WAIT;
+        }
+        status = mysql_real_connect_cont(&ret, conn->mysql, ready);
+    }
+    if(status)
+    {
+        conn->waitStatus = status;
+        conn->deadline = Deadline(conn->mysql, status);
+        return STEP_WAIT;
+    }
+    return ret ? STEP_DONE : STEP_ERROR;
+#else
+    (void)events;
+    net_async_status status = mysql_real_connect_nonblocking(conn->mysql, host_.c_str(), user_.c_str(),
+                                                             passwd_.c_str(), dbName_.c_str(), port_, nullptr, 0);
+    return status == NET_ASYNC_NOT_READY ? STEP_WAIT : status == NET_ASYNC_ERROR ? STEP_ERROR : STEP_DONE;
+#endif
+}
+
+SqlAsync::StepResult SqlAsync::StepQuery_(Conn* conn, uint32_t events){
+    const std::string& sql = conn->op->sql;
+#ifdef SQLASYNC_MARIADB
+    int err = 0;
+    int status;
+    if(!conn->started)
+    {
+        conn->started = true;
+        status = mysql_real_query_start(&err, conn->mysql, sql.data(), sql.size());
+    }
+    else
+    {
+        int ready = ContStatus(conn->waitStatus, events, conn->deadline);
+        if(!ready)
+        {
+            return STEP_WAIT;
+        }
+        status = mysql_real_query_cont(&err, conn->mysql, ready);
+    }
+    if(status)
+    {
+        conn->waitStatus = status;
+        conn->deadline = Deadline(conn->mysql, status);
+        return STEP_WAIT;
+    }
+    return err ? STEP_ERROR : STEP_DONE;
+#else
+    (void)events;
+    net_async_status status = mysql_real_query_nonblocking(conn->mysql, sql.data(), sql.size());
+    return status == NET_ASYNC_NOT_READY ? STEP_WAIT : status == NET_ASYNC_ERROR ? STEP_ERROR : STEP_DONE;
+#endif
+}
+
+SqlAsync::StepResult SqlAsync::StepStore_(Conn* conn, uint32_t events){
+#ifdef SQLASYNC_MARIADB
+    int status;
+    if(!conn->started)
+    {
+        conn->started = true;
+        status = mysql_store_result_start(&conn->res, conn->mysql);
+    }
+    else
+    {
+        int ready = ContStatus(conn->waitStatus, events, conn->deadline);
+        if(!ready)
+        {
+            return STEP_WAIT;
+        }
+        status = mysql_store_result_cont(&conn->res, conn->mysql, ready);
+    }
+    if(status)
+    {
+        conn->waitStatus = status;
+        conn->deadline = Deadline(conn->mysql, status);
+        return STEP_WAIT;
+    }
+#else
+    (void)events;
+    net_async_status status = mysql_store_result_nonblocking(conn->mysql, &conn->res);
+    if(status == NET_ASYNC_NOT_READY)
+    {
+        return STEP_WAIT;
+    }
+    if(status == NET_ASYNC_ERROR)
+    {
+        return STEP_ERROR;
+    }
+#endif
+    //没有结果集：INSERT之类的语句正常返回空，有列却没拿到结果集是出错
+    return conn->res || mysql_field_count(conn->mysql) == 0 ? STEP_DONE : STEP_ERROR;
+}
+
+//边沿触发下，步骤返回等待时socket里可能还有没读的数据，不会再有新的事件，只能等TICK_MS兜底
+//所以偷看一下：还有数据（或者对端已经关闭）就马上再推进一次，直到读到EAGAIN；最多MAX_REDRIVE次，防止库不读时空转
+bool SqlAsync::Redrive_(Conn* conn, int& rounds){
+#ifdef SQLASYNC_MARIADB
+    (void)conn;
+    (void)rounds;
+    return false;//水平触发，还有数据epoll会接着报
+#else
+    if(conn->fd < 0 || ++rounds > MAX_REDRIVE)
+    {
+        return false;
+    }
+    char byte;
+    return recv(conn->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) >= 0;
+#endif
+}
+
+void SqlAsync::Drive_(Conn* conn, uint32_t events){
+    int rounds = 0;
+    while(true)
+    {
+        StepResult step;
+        switch(conn->stage)
+        {
+        case CONN_CONNECTING:
+            step = StepConnect_(conn, events);
+            if(step == STEP_WAIT)
+            {
+                Watch_(conn);
+                if(Redrive_(conn, rounds))
+                {
+                    events = EPOLLIN;
+                    continue;
+                }
+                return;
+            }
+            if(step == STEP_ERROR)
+            {
+                LOG_WARN("SqlAsync connect error: %s", mysql_error(conn->mysql));
+                Reconnect_(conn);
+                return;
+            }
+            conn->backoffMs = 0;
+            SetStage_(conn, CONN_IDLE);
+            conn->loop->idle.push_back(conn);
+            Watch_(conn);
+            return;
+        case CONN_QUERY:
+            step = StepQuery_(conn, events);
+            if(step == STEP_WAIT)
+            {
+                Watch_(conn);
+                if(Redrive_(conn, rounds))
+                {
+                    events = EPOLLIN;
+                    continue;
+                }
+                return;
+            }
+            if(step == STEP_ERROR)
+            {
+                Finish_(conn, mysql_errno(conn->mysql), mysql_error(conn->mysql));
+                return;
+            }
+            SetStage_(conn, CONN_STORE);
+            events = 0;
+            break;//接着取结果
+        case CONN_STORE:
+            step = StepStore_(conn, events);
+            if(step == STEP_WAIT)
+            {
+                Watch_(conn);
+                if(Redrive_(conn, rounds))
+                {
+                    events = EPOLLIN;
+                    continue;
+                }
+                return;
+            }
+            if(step == STEP_ERROR)
+            {
+                Finish_(conn, mysql_errno(conn->mysql), mysql_error(conn->mysql));
+                return;
+            }
+            Finish_(conn, 0, nullptr);
+            return;
+        case CONN_IDLE:
+            //空闲连接上读到数据或者对端关闭，一般是服务端超时断开了，重新连
+            if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            {
+                LOG_INFO("SqlAsync idle connection closed by server");
+                Reconnect_(conn);
+            }
+            return;
+        default:
+            return;
+        }
+    }
+}
+
+void SqlAsync::StartOp_(Conn* conn, Op* op){
+    conn->op = op;
+    SetStage_(conn, CONN_QUERY);
+    Drive_(conn, 0);
+}
+
+void SqlAsync::Finish_(Conn* conn, int err, const char* error){
+    Op* op = conn->op;
+    conn->op = nullptr;
+    SqlResult& result = op->result;
+    if(err)
+    {
+        result.err = err;
+        result.error = error ? error : "";
+    }
+    else if(conn->res)//结果已经全部在客户端，取行不会再读socket
+    {
+        unsigned int fields = mysql_num_fields(conn->res);
+        MYSQL_ROW row;
+        while((row = mysql_fetch_row(conn->res)))
+        {
+            unsigned long* lengths = mysql_fetch_lengths(conn->res);
+            std::vector<std::string> values(fields);
+            for(unsigned int i = 0; i < fields; i++)
+            {
+                if(row[i])
+                {
+                    values[i].assign(row[i], lengths[i]);
+                }
+            }
+            result.rows.push_back(std::move(values));
+        }
+    }
+    else
+    {
+        result.affected = mysql_affected_rows(conn->mysql);
+    }
+    if(conn->res)
+    {
+        mysql_free_result(conn->res);
+        conn->res = nullptr;
+    }
+    if(IsConnectionLost(err))
+    {
+        Reconnect_(conn);
+    }
+    else
+    {
+        SetStage_(conn, CONN_IDLE);
+        conn->loop->idle.push_back(conn);
+        Watch_(conn);
+    }
+    inFlight_.fetch_sub(1, std::memory_order_relaxed);
+    op->cb(result);
+    delete op;
+}
+
+void SqlAsync::Reconnect_(Conn* conn){
+    Loop* loop = conn->loop;
+    if(conn->stage == CONN_IDLE)
+    {
+        for(size_t i = 0; i < loop->idle.size(); i++)
+        {
+            if(loop->idle[i] == conn)
+            {
+                loop->idle[i] = loop->idle.back();
+                loop->idle.pop_back();
+                break;
+            }
+        }
+    }
+    if(conn->fd >= 0)//先从epoll摘掉，新连接可能复用同一个fd号
+    {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        conn->fd = -1;
+    }
+    if(conn->res)
+    {
+        mysql_free_result(conn->res);
+        conn->res = nullptr;
+    }
+    mysql_close(conn->mysql);
+    conn->mysql = NewHandle();
+    conn->backoffMs = conn->backoffMs ? conn->backoffMs * 2 : RETRY_BASE_MS;
+    if(conn->backoffMs > MAX_BACKOFF_MS)
+    {
+        conn->backoffMs = MAX_BACKOFF_MS;
+    }
+    conn->retryAt = Clock::now() + std::chrono::milliseconds(conn->backoffMs);
+    SetStage_(conn, CONN_CLOSED);
+}
+
+void SqlAsync::Dispatch_(Loop* loop){
+    {
+        std::lock_guard<std::mutex> locker(loop->mtx);
+        while(!loop->incoming.empty())
+        {
+            loop->pending.push_back(loop->incoming.front());
+            loop->incoming.pop_front();
+        }
+    }
+    while(!loop->pending.empty() && !loop->idle.empty())
+    {
+        Conn* conn = loop->idle.back();
+        loop->idle.pop_back();
+        Op* op = loop->pending.front();
+        loop->pending.pop_front();
+        StartOp_(conn, op);
+    }
+    //一个连接都没连上、也没有正在连的，数据库大概是不可用，不让查询无限排队
+    if(!loop->pending.empty() && loop->connected == 0 && loop->busy == 0)
+    {
+        while(!loop->pending.empty())
+        {
+            Op* op = loop->pending.front();
+            loop->pending.pop_front();
+            op->result.err = CR_SERVER_GONE_ERROR;
+            op->result.error = "no database connection";
+            inFlight_.fetch_sub(1, std::memory_order_relaxed);
+            op->cb(op->result);
+            delete op;
+        }
+    }
+}
+
+int SqlAsync::Timeout_(Loop* loop){
+    if(loop->busy > 0)
+    {
+        return TICK_MS;
+    }
+    if(loop->closed == 0)
+    {
+        return -1;
+    }
+    Clock::time_point now = Clock::now();
+    Clock::time_point earliest = Clock::time_point::max();
+    for(auto& conn : loop->conns)
+    {
+        if(conn->stage == CONN_CLOSED && conn->retryAt < earliest)
+        {
+            earliest = conn->retryAt;
+        }
+    }
+    if(earliest <= now)
+    {
+        return 0;
+    }
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(earliest - now).count()) + 1;
+}
+
+void SqlAsync::Run_(Loop* loop){
+    mysql_thread_init();
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    while(!loop->stop)
+    {
+        int n = epoll_wait(loop->epfd, events, MAX_EVENTS, Timeout_(loop));
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("SqlAsync epoll_wait error: %d", errno);
+            break;
+        }
+        for(int i = 0; i < n; i++)
+        {
+            if(!events[i].data.ptr)
+            {
+                uint64_t count;
+                ssize_t r = read(loop->evfd, &count, sizeof(count));
+                (void)r;
+                continue;
+            }
+            Drive_(static_cast<Conn*>(events[i].data.ptr), events[i].events);
+        }
+        if(loop->closed > 0 || (n == 0 && loop->busy > 0))
+        {
+            Clock::time_point now = Clock::now();
+            for(auto& conn : loop->conns)
+            {
+                if(conn->stage == CONN_CLOSED && conn->retryAt <= now)
+                {
+                    SetStage_(conn.get(), CONN_CONNECTING);
+                    Drive_(conn.get(), 0);
+                }
+                else if(n == 0 && conn->stage != CONN_CLOSED && conn->stage != CONN_IDLE)
+                {
+                    Drive_(conn.get(), 0);//超时兜底：再试一次，没有进展的调用会直接返回
+                }
+            }
+        }
+        Dispatch_(loop);
+    }
+
+    //关闭：所有没完成的查询以错误结束
+    {
+        std::lock_guard<std::mutex> locker(loop->mtx);
+        while(!loop->incoming.empty())
+        {
+            loop->pending.push_back(loop->incoming.front());
+            loop->incoming.pop_front();
+        }
+    }
+    for(auto& conn : loop->conns)
+    {
+        if(conn->op)
+        {
+            loop->pending.push_back(conn->op);
+            conn->op = nullptr;
+        }
+        if(conn->res)
+        {
+            mysql_free_result(conn->res);
+            conn->res = nullptr;
+        }
+        mysql_close(conn->mysql);
+        conn->mysql = nullptr;
+    }
+    while(!loop->pending.empty())
+    {
+        Op* op = loop->pending.front();
+        loop->pending.pop_front();
+        op->result.err = -1;
+        op->result.error = "SqlAsync closed";
+        inFlight_.fetch_sub(1, std::memory_order_relaxed);
+        op->cb(op->result);
+        delete op;
+    }
+    mysql_thread_end();
+}
@@ -0,0 +1,131 @@
+#ifndef SQLASYNC_H
+#define SQLASYNC_H
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "log.h"
+
+//MariaDB Connector/C的非阻塞接口是*_start/*_cont，MySQL 8.0.16以后是*_nonblocking
+#if defined(LIBMARIADB) || defined(MARIADB_BASE_VERSION)
+#define SQLASYNC_MARIADB 1
+#endif
+
+struct SqlResult {
+    int err; //0表示成功，否则是mysql的错误码
+    std::string error;
+    std::vector<std::vector<std::string>> rows; //NULL列是空串
+    uint64_t affected; //没有结果集的语句影响的行数
+
+    SqlResult() : err(0), affected(0) {}
+};
+
+// 异步查询：用客户端库的非阻塞接口，连接的socket挂在epoll上，由少数几个事件循环线程驱动
+// 一个连接同时只跑一条语句，在途的查询数等于连接数；线程数只需要和CPU相当，连接可以开几百个
+// 每个循环线程独占自己的一组连接，提交的查询经eventfd唤醒，按轮转分给各个循环
+// 连接断开时当前查询以错误结束，连接在后台按退避时间重连
+// 用的是文本协议，SQL里的字符串参数要先用Escape转义
+class SqlAsync {
+public:
+    typedef std::function<void(SqlResult&)> Callback;
+
+    static SqlAsync* Instance();
+
+    bool Init(const char* host, int port, const char* user, const char* passwd, const char* dbName,
+              int connSize, int loopThreads); //连接在循环线程里异步建立，Init不等它们连上
+    void Close(); //未完成的查询以错误结束
+
+    //回调在事件循环线程上执行，不能阻塞；结果可以移走
+    void Query(std::string sql, Callback cb);
+    std::future<SqlResult> Query(std::string sql);
+
+    std::string Escape(const std::string& str);
+
+    int InFlight() { return inFlight_.load(std::memory_order_relaxed); } //已提交还没回调的查询数
+    int Connected(); //当前已连上的连接数
+
+private:
+    SqlAsync();
+    ~SqlAsync() { Close(); }
+
+    static const int RETRY_BASE_MS = 100;
+    static const int MAX_BACKOFF_MS = 5000;
+    static const int TICK_MS = 50; //有查询在途时epoll_wait的超时，防止漏掉就绪事件时卡住
+    static const int MAX_REDRIVE = 16; //一次事件里因为socket还有数据而连续推进的最多次数
+
+    typedef std::chrono::steady_clock Clock;
+
+    enum ConnStage { CONN_CLOSED, CONN_CONNECTING, CONN_IDLE, CONN_QUERY, CONN_STORE };
+    enum StepResult { STEP_DONE, STEP_WAIT, STEP_ERROR };
+
+    struct Op {
+        std::string sql;
+        Callback cb;
+        SqlResult result;
+    };
+
+    struct Loop;
+    struct Conn {
+        Loop* loop;
+        MYSQL* mysql;
+        int fd; //已经注册到epoll的socket，-1表示没有
+        int stage; //ConnStage
+        bool started; //当前阶段的非阻塞调用是否已经开始（MariaDB要区分_start和_cont）
+        int waitStatus; //MariaDB要求等待的事件
+        Op* op;
+        MYSQL_RES* res;
+        Clock::time_point retryAt; //CONN_CLOSED时下一次重连的时间
+        Clock::time_point deadline; //MariaDB要求的超时时刻
+        int backoffMs;
+    };
+
+    struct Loop {
+        int epfd;
+        int evfd; //提交查询和关闭时唤醒
+        std::mutex mtx;
+        std::deque<Op*> incoming; //其他线程提交的，由mtx保护
+        std::deque<Op*> pending; //还没分到连接的，只有循环线程访问
+        std::vector<std::unique_ptr<Conn>> conns;
+        std::vector<Conn*> idle;
+        std::atomic<int> connected; //IDLE、QUERY、STORE状态的连接数
+        int busy; //CONNECTING、QUERY、STORE状态的连接数，只有循环线程访问
+        int closed; //CLOSED状态（等待重连）的连接数
+        std::atomic<bool> stop;
+        std::thread thread;
+    };
+
+    void Run_(Loop* loop);
+    int Timeout_(Loop* loop); //epoll_wait的超时：有连接在忙时定时兜底，否则等到最早的重连时间
+    void Dispatch_(Loop* loop);
+    void SetStage_(Conn* conn, int stage); //同时维护循环的计数
+    void Drive_(Conn* conn, uint32_t events); //推进连接上的状态机，直到需要等socket
+    bool Redrive_(Conn* conn, int& rounds); //返回等待时socket里是否还有没读的数据，要接着推进
+    void StartOp_(Conn* conn, Op* op);
+    void Finish_(Conn* conn, int err, const char* error);
+    void Reconnect_(Conn* conn); //关掉旧连接，按退避时间安排重连
+    void Watch_(Conn* conn);
+
+    StepResult StepConnect_(Conn* conn, uint32_t events);
+    StepResult StepQuery_(Conn* conn, uint32_t events);
+    StepResult StepStore_(Conn* conn, uint32_t events);
+
+    std::string host_, user_, passwd_, dbName_;
+    int port_;
+    std::vector<std::unique_ptr<Loop>> loops_; //由loopsMtx_保护（Init时还没有别的线程）
+    std::mutex loopsMtx_; //Query、Connected和Close互斥
+    std::atomic<uint32_t> next_; //轮转选循环
+    std::atomic<int> inFlight_;
+    MYSQL* escaper_; //只用来转义，不连接
+    std::mutex escMtx_;
+};
+
+#endif
@@ -1,8 +1,18 @@
 #include "sqlconnpool.h"
 #include "log.h"
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
+#include <atomic>
+#include <vector>
 
-SqlConnPool::SqlConnPool() {
-    // 可以初始化成员变量，也可以留空
+thread_local int SqlConnPool::hint_ = -1;
+
+SqlConnPool::SqlConnPool() : freeHead_(0), port_(0), max_CONN_SIZE(0), opened_(0), growBackoffMs_(0),
+                             waiters_(0), timeouts_(0) {
+    for(int i = 0; i < WAIT_BUCKETS; i++)
+    {
+        waitHist_[i] = 0;
+    }
 }
 
 SqlConnPool* SqlConnPool::Instance(){
@@ -10,67 +20,598 @@ SqlConnPool* SqlConnPool::Instance(){
     return &poll;
 }
 
+//打开全部connSize个连接，多个线程并行连接，启动耗时约等于单个连接的耗时
 void SqlConnPool::Init(const char*host,int port,const char* user,const char* passwd,const char* dbName,int connSize=20){
-    assert(connSize>0);
-    for(int i=0;i<connSize;i++)
+    InitLazy(host, port, user, passwd, dbName, connSize, connSize);
+}
+
+//先并行打开minSize个连接，之后GetConn时没有空闲连接再按需增长，最多maxSize个
+//连不上不再assert：记日志，按需增长时退避重试
+void SqlConnPool::InitLazy(const char* host, int port, const char* user, const char* passwd, const char* dbName,
+                           int minSize, int maxSize){
+    assert(minSize >= 0 && maxSize > 0 && minSize <= maxSize);
+    host_ = host ? host : "";
+    user_ = user ? user : "";
+    passwd_ = passwd ? passwd : "";
+    dbName_ = dbName ? dbName : "";
+    port_ = port;
+    slots_.reset(new Slot[maxSize]);
+    for(int i = 0; i < maxSize; i++)
     {
-        MYSQL* conn = nullptr;
-        conn = mysql_init(conn);
-        if(!conn)
+        slots_[i].state = SLOT_EMPTY;
+        slots_[i].inList = false;
+        slots_[i].next = 0;
+        slots_[i].conn = nullptr;
+    }
+    freeHead_ = 0;
+    max_CONN_SIZE = maxSize;
+    opened_ = 0;
+    growBackoffMs_ = 0;
+    nextGrow_ = std::chrono::steady_clock::now();
+    mysql_library_init(0, nullptr, nullptr);//必须在多个线程同时mysql_init之前单独调用一次
+    int ok = OpenParallel_(minSize);
+    if(ok < minSize)
+    {
+        LOG_ERROR("Mysql connect pool: only %d of %d connections opened", ok, minSize);
+    }
+    LOG_INFO("Mysql connect pool init success, %d opened, max %d", ok, maxSize);
+}
+
+//在调用方给的句柄上打开连接；句柄不是mysql_init(nullptr)分配的，mysql_close只释放内部资源，可以原地再连
+//不用MYSQL_OPT_RECONNECT（已废弃，而且自动重连会悄悄丢掉会话状态），断线由Reconnect_显式重连
+bool SqlConnPool::Connect_(MYSQL* handle, int attempts){
+    int backoffMs = RETRY_BASE_MS;
+    for(int attempt = 0; attempt < attempts; attempt++)
+    {
+        if(attempt > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+            backoffMs *= 2;
+        }
+        if(!mysql_init(handle))
         {
             LOG_ERROR("Mysql init error");
-            assert(conn);
+            continue;
         }
-        conn = mysql_real_connect(conn,host,user,passwd,dbName,port,nullptr,0);
-        if(!conn)
+        if(mysql_real_connect(handle, host_.c_str(), user_.c_str(), passwd_.c_str(), dbName_.c_str(), port_, nullptr, 0))
+        {
+            return true;
+        }
+        LOG_ERROR("Mysql connect error(%d/%d): %s", attempt + 1, attempts, mysql_error(handle));
+        mysql_close(handle);
+    }
+    return false;
+}
+
+//调用方持有这个连接：丢掉旧语句，关掉断开的连接，在同一个句柄上重新连一次，持有者手里的指针不变
+//连不上时句柄保持初始化但未连接的状态，下次用到时还是报连接断开，会再来重连
+bool SqlConnPool::Reconnect_(MYSQL* conn){
+    Slot* slot = SlotOf_(conn);
+    assert(slot && conn == &slot->handle);
+    CloseStmts_(slot->stmts);
+    mysql_close(conn);
+    if(Connect_(conn, 1))
+    {
+        LOG_INFO("Mysql reconnected");
+        return true;
+    }
+    mysql_init(conn);
+    return false;
+}
+
+//占一个空槽（EMPTY -> BUSY），用来放新建好的连接
+int SqlConnPool::ReserveSlot_(){
+    for(int i = 0; i < max_CONN_SIZE; i++)
+    {
+        int expect = SLOT_EMPTY;
+        if(slots_[i].state.compare_exchange_strong(expect, SLOT_BUSY))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int SqlConnPool::OpenParallel_(int n){
+    if(n <= 0)
+    {
+        return 0;
+    }
+    opened_ += n;//先占上名额，连不上的再还回去
+    std::atomic<int> next(0);
+    std::atomic<int> ok(0);
+    auto worker = [this, n, &next, &ok]() {
+        mysql_thread_init();//每个用到客户端库的线程都要初始化线程局部状态
+        while(next.fetch_add(1) < n)
+        {
+            int i = ReserveSlot_();//先占槽，直接连在槽里的句柄上
+            assert(i >= 0);
+            if(!Connect_(&slots_[i].handle, CONNECT_RETRY))
+            {
+                slots_[i].state.store(SLOT_EMPTY, std::memory_order_release);
+                continue;
+            }
+            slots_[i].conn = &slots_[i].handle;
+            slots_[i].state.store(SLOT_FREE, std::memory_order_release);
+            Push_(i);
+            ok++;
+        }
+        mysql_thread_end();
+    };
+    int threads = n < INIT_THREADS ? n : INIT_THREADS;
+    std::vector<std::thread> pool;
+    for(int i = 1; i < threads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();//当前线程也干活
+    for(std::thread& t : pool)
+    {
+        t.join();
+    }
+    opened_ -= n - ok.load();
+    return ok.load();
+}
+
+//没有空闲连接时按需多开一个；上次失败后在退避时间内不再尝试，避免数据库不可用时每次请求都去连
+MYSQL* SqlConnPool::Grow_(){
+    {
+        std::lock_guard<std::mutex> locker(mtx);
+        if(opened_.load() >= max_CONN_SIZE || std::chrono::steady_clock::now() < nextGrow_)
+        {
+            return nullptr;
+        }
+        opened_++;
+    }
+    int i = ReserveSlot_();
+    assert(i >= 0);
+    if(!Connect_(&slots_[i].handle, CONNECT_RETRY))
+    {
+        slots_[i].state.store(SLOT_EMPTY, std::memory_order_release);
+        std::lock_guard<std::mutex> locker(mtx);
+        opened_--;
+        growBackoffMs_ = growBackoffMs_ ? growBackoffMs_ * 2 : RETRY_BASE_MS;
+        if(growBackoffMs_ > MAX_BACKOFF_MS)
+        {
+            growBackoffMs_ = MAX_BACKOFF_MS;
+        }
+        nextGrow_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(growBackoffMs_);
+        return nullptr;
+    }
+    MYSQL* conn = &slots_[i].handle;
+    slots_[i].conn = conn;
+    hint_ = i;
+    {
+        std::lock_guard<std::mutex> locker(mtx);
+        growBackoffMs_ = 0;
+    }
+    LOG_INFO("Mysql connect pool grew to %d", opened_.load());
+    return conn;
+}
+
+bool SqlConnPool::TakeSlot_(uint32_t i){
+    int expect = SLOT_FREE;
+    return slots_[i].state.load(std::memory_order_relaxed) == SLOT_FREE &&
+           slots_[i].state.compare_exchange_strong(expect, SLOT_BUSY, std::memory_order_acquire);
+}
+
+//Treiber栈，头部带版本号，同一个下标被弹出又压回也不会误判
+void SqlConnPool::Push_(uint32_t i){
+    bool expect = false;
+    if(!slots_[i].inList.compare_exchange_strong(expect, true))//已经在栈里
+    {
+        return;
+    }
+    uint64_t head = freeHead_.load(std::memory_order_relaxed);
+    uint64_t update;
+    do
+    {
+        slots_[i].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        update = ((head >> 32) + 1) << 32 | (i + 1);
+    } while(!freeHead_.compare_exchange_weak(head, update, std::memory_order_release, std::memory_order_relaxed));
+}
+
+int SqlConnPool::Pop_(){
+    uint64_t head = freeHead_.load(std::memory_order_acquire);
+    while(static_cast<uint32_t>(head) != 0)
+    {
+        uint32_t i = static_cast<uint32_t>(head) - 1;
+        uint64_t update = ((head >> 32) + 1) << 32 | slots_[i].next.load(std::memory_order_relaxed);
+        if(freeHead_.compare_exchange_weak(head, update, std::memory_order_acquire, std::memory_order_acquire))
+        {
+            slots_[i].inList.store(false);//之后这个槽再被释放时可以重新压栈
+            return i;
+        }
+    }
+    return -1;
+}
+
+MYSQL* SqlConnPool::TryAcquire_(){
+    if(!slots_)
+    {
+        return nullptr;
+    }
+    int hint = hint_;
+    if(hint >= 0 && hint < max_CONN_SIZE && TakeSlot_(hint))//同一线程尽量用同一个连接
+    {
+        return slots_[hint].conn;
+    }
+    //栈里的槽可能已经被别的线程通过hint拿走，拿不到就丢掉继续弹；它被释放时会重新压栈
+    for(int i = Pop_(); i >= 0; i = Pop_())
+    {
+        if(TakeSlot_(i))
+        {
+            hint_ = i;
+            return slots_[i].conn;
+        }
+    }
+    for(int i = 0; i < max_CONN_SIZE; i++)//兜底扫一遍
+    {
+        if(TakeSlot_(i))
         {
-            LOG_ERROR("Mysql connect error");
-            assert(conn);
+            hint_ = i;
+            return slots_[i].conn;
         }
-        conn_queue.emplace(conn);//这句代码的作用是将连接对象conn放入连接池的队列中
-    }                                  
-    max_CONN_SIZE = connSize;
-    sem_init(&sem,0,max_CONN_SIZE);//&sem：信号量变量的地址，表示该信号量是线程间共享（而不是进程间共享）。
-                                       //0：表示该信号量是线程间共享（而不是进程间共享）。
-                                       //max_CONN_SIZE：信号量的初始值，通常等于连接池的最大连接数。
-    LOG_INFO("Mysql connect pool init success");
+    }
+    return nullptr;
+}
+
+void SqlConnPool::Record_(uint64_t waitUs){
+    int bucket = 0;
+    while(waitUs > 0 && bucket < WAIT_BUCKETS - 1)
+    {
+        waitUs >>= 1;
+        bucket++;
+    }
+    waitHist_[bucket].fetch_add(1, std::memory_order_relaxed);
 }
 
 MYSQL* SqlConnPool::GetConn(){
-    MYSQL* conn = nullptr;
-    if(conn_queue.empty())
+    return GetConn(-1);
+}
+
+MYSQL* SqlConnPool::GetConn(int timeoutMs){
+    MYSQL* conn = TryAcquire_();
+    if(conn)
+    {
+        Record_(0);
+        return conn;
+    }
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    conn = Grow_();
+    if(!conn && opened_.load() == 0)//一个连接都没有，等也等不到
     {
         LOG_ERROR("conn queue is empty");
         return nullptr;
     }
-    sem_wait(&sem);//如果 sem 的值大于 0，则 sem 的值减 1，函数立即返回，表示成功获取到一个资源（比如数据库连接）。
-    std::lock_guard<std::mutex> locker(mutex);
-    conn = conn_queue.front();//获取队列的第一个连接
-    conn_queue.pop();//将队列的第一个连接弹出
-    return conn;//返回获取到的连接给需要的线程使用
+    Clock::time_point deadline = start + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    while(!conn)
+    {
+        std::unique_lock<std::mutex> locker(mtx);
+        waiters_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        conn = TryAcquire_();//登记之后再试一次，FreeConn看到waiters_才会通知，不会漏掉
+        if(!conn)
+        {
+            if(timeoutMs < 0)
+            {
+                cond_.wait(locker);
+            }
+            else if(cond_.wait_until(locker, deadline) == std::cv_status::timeout)
+            {
+                waiters_--;
+                locker.unlock();
+                conn = TryAcquire_();
+                if(!conn)
+                {
+                    timeouts_++;
+                    LOG_WARN("Mysql connect pool exhausted, GetConn timed out after %d ms", timeoutMs);
+                    return nullptr;
+                }
+                break;
+            }
+        }
+        waiters_--;
+    }
+    Record_(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    return conn;
+}
+
+SqlConnPool::Slot* SqlConnPool::SlotOf_(MYSQL* conn){
+    int hint = hint_;
+    if(hint >= 0 && hint < max_CONN_SIZE && slots_[hint].conn == conn)
+    {
+        return &slots_[hint];
+    }
+    for(int i = 0; i < max_CONN_SIZE; i++)
+    {
+        if(slots_[i].state.load(std::memory_order_acquire) != SLOT_EMPTY && slots_[i].conn == conn)
+        {
+            return &slots_[i];
+        }
+    }
+    return nullptr;
 }
 
 void SqlConnPool::FreeConn(MYSQL* conn){
     assert(conn);
-    std::lock_guard<std::mutex> locker(mutex);
-    conn_queue.push(conn);//把归还的连接放回队列
-    sem_post(&sem);//信号量加1，表示有一个连接可用
+    Slot* slot = SlotOf_(conn);
+    assert(slot);
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+    Push_(static_cast<uint32_t>(slot - &slots_[0]));
+    std::atomic_thread_fence(std::memory_order_seq_cst);//和GetConn里登记waiters_之后的重试配对，不会双方都没看到对方
+    if(waiters_.load() > 0)
+    {
+        std::lock_guard<std::mutex> locker(mtx);//加锁再通知，避免和等待方的检查交错而丢失唤醒
+        cond_.notify_one();
+    }
 }
 
 void SqlConnPool::ClosePool(){
-    std::lock_guard<std::mutex> locker(mutex);
-    while(!conn_queue.empty())
+    std::lock_guard<std::mutex> locker(mtx);
+    if(max_CONN_SIZE == 0)//没有初始化过
+    {
+        return;
+    }
+    for(int i = 0; i < max_CONN_SIZE; i++)
     {
-        MYSQL* conn = conn_queue.front();
-        conn_queue.pop();
-        mysql_close(conn);//关闭连接
+        Slot& slot = slots_[i];
+        if(slot.conn)
+        {
+            CloseStmts_(slot.stmts);
+            mysql_close(slot.conn);//关闭连接
+        }
     }
+    slots_.reset();
+    freeHead_ = 0;
+    opened_ = 0;
+    max_CONN_SIZE = 0;
     mysql_library_end();//结束mysql库
-    sem_destroy(&sem);//销毁信号量
     LOG_INFO("Mysql connect pool close success");
 }
 
 int SqlConnPool::GetFreeConnNum(){
-    std::lock_guard<std::mutex> locker(mutex);
-    return conn_queue.size();
-}
\ No newline at end of file
+    int n = 0;
+    for(int i = 0; i < max_CONN_SIZE; i++)
+    {
+        n += slots_[i].state.load(std::memory_order_relaxed) == SLOT_FREE;
+    }
+    return n;
+}
+
+int SqlConnPool::GetConnNum(){
+    return opened_.load();
+}
+
+void SqlConnPool::GetWaitHistogram(uint64_t out[WAIT_BUCKETS]){
+    for(int i = 0; i < WAIT_BUCKETS; i++)
+    {
+        out[i] = waitHist_[i].load(std::memory_order_relaxed);
+    }
+}
+
+SqlConnPool::StmtCache& SqlConnPool::CacheOf_(MYSQL* conn){
+    Slot* slot = SlotOf_(conn);
+    assert(slot);
+    return slot->stmts;
+}
+
+void SqlConnPool::CloseStmts_(StmtCache& cache){
+    for(auto& item : cache.stmts)
+    {
+        mysql_stmt_close(item.second);
+    }
+    cache.stmts.clear();
+}
+
+MYSQL_STMT* SqlConnPool::Prepare(MYSQL* conn, const char* sql){
+    assert(conn && sql);
+    StmtCache& cache = CacheOf_(conn);
+    auto it = cache.stmts.find(sql);
+    if(it != cache.stmts.end())
+    {
+        return it->second;
+    }
+    MYSQL_STMT* stmt = mysql_stmt_init(conn);
+    if(!stmt)
+    {
+        LOG_ERROR("Mysql stmt init error");
+        return nullptr;
+    }
+    if(mysql_stmt_prepare(stmt, sql, strlen(sql)))
+    {
+        LOG_ERROR("Mysql prepare error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    cache.stmts.emplace(sql, stmt);
+    return stmt;
+}
+
+static bool IsConnectionLost(unsigned int err){
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+MYSQL_STMT* SqlConnPool::Execute_(MYSQL* conn, const char* sql, MYSQL_BIND* params, MYSQL_BIND* result,
+                                  unsigned int* errOut){
+    for(int attempt = 0; attempt < 2; attempt++)
+    {
+        MYSQL_STMT* stmt = Prepare(conn, sql);
+        unsigned int err = 0;
+        if(!stmt)
+        {
+            err = mysql_errno(conn);
+        }
+        else if(mysql_stmt_bind_param(stmt, params) || (result && mysql_stmt_bind_result(stmt, result)))
+        {
+            LOG_ERROR("Mysql bind error: %s", mysql_stmt_error(stmt));
+            return nullptr;
+        }
+        else if(mysql_stmt_execute(stmt) || (result && mysql_stmt_store_result(stmt)))
+        {
+            err = mysql_stmt_errno(stmt);
+            if(err != ER_DUP_ENTRY)//唯一键冲突是调用方要处理的正常结果，不算错误
+            {
+                LOG_ERROR("Mysql execute error: %s", mysql_stmt_error(stmt));
+            }
+            mysql_stmt_reset(stmt);
+        }
+        else
+        {
+            return stmt;
+        }
+        if(errOut)
+        {
+            *errOut = err;
+        }
+        if(attempt > 0 || !IsConnectionLost(err) || !Reconnect_(conn))//只有连接断开且重连成功时才重试
+        {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+int SqlConnPool::QueryUser(MYSQL* conn, const std::string& user, std::string* passwd){
+    //按字节比较（和QueryUsers一致）：列的排序规则通常大小写不敏感，批量查询按字节分发结果时两条路径会不一致
+    //CAST放在参数一侧，username上的索引仍然可用
+    static const char* SQL = "SELECT password FROM user WHERE username = CAST(? AS BINARY) LIMIT 1";
+    MYSQL_BIND param;
+    memset(&param, 0, sizeof(param));
+    unsigned long userLen = user.size();
+    param.buffer_type = MYSQL_TYPE_STRING;
+    param.buffer = const_cast<char*>(user.data());
+    param.buffer_length = userLen;
+    param.length = &userLen;
+
+    char pwd[256];//结果直接写进栈上的缓冲区，不经过MYSQL_RES
+    unsigned long pwdLen = 0;
+    bool isNull = false;
+    MYSQL_BIND result;
+    memset(&result, 0, sizeof(result));
+    result.buffer_type = MYSQL_TYPE_STRING;
+    result.buffer = pwd;
+    result.buffer_length = sizeof(pwd);
+    result.length = &pwdLen;
+    result.is_null = &isNull;
+
+    MYSQL_STMT* stmt = Execute_(conn, SQL, &param, &result);
+    if(!stmt)
+    {
+        return -1;
+    }
+    int ret = mysql_stmt_fetch(stmt);
+    int found = -1;
+    if(ret == 0)
+    {
+        found = 1;
+        if(passwd)
+        {
+            passwd->assign(pwd, isNull ? 0 : pwdLen);
+        }
+    }
+    else if(ret == MYSQL_NO_DATA)
+    {
+        found = 0;
+    }
+    else
+    {
+        LOG_ERROR(ret == MYSQL_DATA_TRUNCATED ? "Mysql password column too long" : "Mysql fetch error: %s",
+                  mysql_stmt_error(stmt));
+    }
+    mysql_stmt_free_result(stmt);
+    return found;
+}
+
+int SqlConnPool::InsertUser(MYSQL* conn, const std::string& user, const std::string& passwd){
+    static const char* SQL = "INSERT INTO user(username, password) VALUES(?, ?)";
+    MYSQL_BIND params[2];
+    memset(params, 0, sizeof(params));
+    unsigned long userLen = user.size();
+    unsigned long pwdLen = passwd.size();
+    params[0].buffer_type = MYSQL_TYPE_STRING;
+    params[0].buffer = const_cast<char*>(user.data());
+    params[0].buffer_length = userLen;
+    params[0].length = &userLen;
+    params[1].buffer_type = MYSQL_TYPE_STRING;
+    params[1].buffer = const_cast<char*>(passwd.data());
+    params[1].buffer_length = pwdLen;
+    params[1].length = &pwdLen;
+    unsigned int err = 0;
+    if(Execute_(conn, SQL, params, nullptr, &err))
+    {
+        return 1;
+    }
+    return err == ER_DUP_ENTRY ? 0 : -1;
+}
+
+int SqlConnPool::QueryUsers(MYSQL* conn, const std::vector<std::string>& users,
+                            std::unordered_map<std::string, std::string>* rows){
+    assert(rows);
+    if(users.empty())
+    {
+        return 0;
+    }
+    size_t n = 1;
+    while(n < users.size())
+    {
+        n <<= 1;
+    }
+    std::string sql = "SELECT username, password FROM user WHERE username IN (CAST(? AS BINARY)";
+    for(size_t i = 1; i < n; i++)
+    {
+        sql += ",CAST(? AS BINARY)";
+    }
+    sql += ")";
+
+    std::vector<MYSQL_BIND> params(n);
+    std::vector<unsigned long> lens(n);
+    memset(params.data(), 0, sizeof(MYSQL_BIND) * n);
+    for(size_t i = 0; i < n; i++)
+    {
+        const std::string& user = users[i < users.size() ? i : users.size() - 1];
+        lens[i] = user.size();
+        params[i].buffer_type = MYSQL_TYPE_STRING;
+        params[i].buffer = const_cast<char*>(user.data());
+        params[i].buffer_length = lens[i];
+        params[i].length = &lens[i];
+    }
+
+    char name[256], pwd[256];
+    unsigned long nameLen = 0, pwdLen = 0;
+    bool nameNull = false, pwdNull = false;
+    MYSQL_BIND result[2];
+    memset(result, 0, sizeof(result));
+    result[0].buffer_type = MYSQL_TYPE_STRING;
+    result[0].buffer = name;
+    result[0].buffer_length = sizeof(name);
+    result[0].length = &nameLen;
+    result[0].is_null = &nameNull;
+    result[1].buffer_type = MYSQL_TYPE_STRING;
+    result[1].buffer = pwd;
+    result[1].buffer_length = sizeof(pwd);
+    result[1].length = &pwdLen;
+    result[1].is_null = &pwdNull;
+
+    MYSQL_STMT* stmt = Execute_(conn, sql.c_str(), params.data(), result);
+    if(!stmt)
+    {
+        return -1;
+    }
+    int count = 0;
+    int ret;
+    while((ret = mysql_stmt_fetch(stmt)) == 0)
+    {
+        (*rows)[std::string(name, nameNull ? 0 : nameLen)].assign(pwd, pwdNull ? 0 : pwdLen);
+        count++;
+    }
+    if(ret != MYSQL_NO_DATA)
+    {
+        LOG_ERROR(ret == MYSQL_DATA_TRUNCATED ? "Mysql user column too long" : "Mysql fetch error: %s",
+                  mysql_stmt_error(stmt));
+        count = -1;
+    }
+    mysql_stmt_free_result(stmt);
+    return count;
+}
@@ -3,31 +3,113 @@
 
 #include <mysql/mysql.h>
 #include <string>
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <unordered_map>
 #include <mutex>
-#include <semaphore.h>
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
 #include "log.h"
 
 class SqlConnPool {
 public:
+    static const int WAIT_BUCKETS = 24; //等待时间直方图的桶数
+
     static SqlConnPool* Instance();
 
-    MYSQL* GetConn();//获取一个连接
+    MYSQL* GetConn();//获取一个连接，池子用光时一直等
+    MYSQL* GetConn(int timeoutMs);//最多等timeoutMs毫秒，超时返回nullptr
     void FreeConn(MYSQL* conn);//释放一个连接
     int GetFreeConnNum(); //获取空闲连接数
+    int GetConnNum(); //已经打开的连接数
+
+    //GetConn的等待时间分布：第0桶是不用等直接拿到的，第k桶是[2^(k-1), 2^k)微秒，最后一桶包括更长的
+    void GetWaitHistogram(uint64_t out[WAIT_BUCKETS]);
+    uint64_t GetTimeouts() { return timeouts_.load(std::memory_order_relaxed); }
+
+    void Init(const char* host, int port,const char* user, const char* passwd,const char* dbName,int connSize); //初始化连接池，并行打开全部连接
+    void InitLazy(const char* host, int port, const char* user, const char* passwd, const char* dbName,
+                  int minSize, int maxSize); //先打开minSize个，不够用时按需增长到maxSize
+    void ClosePool(); //关闭连接池，调用前所有连接都要已经归还
 
-    void Init(const char* host, int port,const char* user, const char* passwd,const char* dbName,int connSize); //初始化连接池
-    void ClosePool(); //关闭连接池
+    //预处理语句缓存：每个连接按SQL文本缓存自己的MYSQL_STMT，只在第一次用到时prepare
+    //连接断开重连时旧语句全部作废，下次用到时重新prepare
+    //调用者必须持有这个连接（GetConn之后、FreeConn之前），返回的语句只能在这个连接上用
+    MYSQL_STMT* Prepare(MYSQL* conn, const char* sql);
+
+    //用户表的类型化查询，参数走绑定，不需要转义；连接断开时自动重连、重新prepare并重试一次
+    int QueryUser(MYSQL* conn, const std::string& user, std::string* passwd);//找到返回1，没有返回0，出错返回-1
+    //插入返回1，用户名已存在返回0（靠username上的唯一键报ER_DUP_ENTRY），出错返回-1
+    int InsertUser(MYSQL* conn, const std::string& user, const std::string& passwd);
+    //一次查多个用户：WHERE username IN (?,...)，占位符个数补齐到2的幂（重复最后一个用户名），语句缓存里最多只有几条
+    //用户名和QueryUser一样按字节比较，返回的用户名和请求的字节完全相同
+    //查到的行写进rows（用户名 -> 密码），返回行数，出错返回-1
+    int QueryUsers(MYSQL* conn, const std::vector<std::string>& users,
+                   std::unordered_map<std::string, std::string>* rows);
 
 private:
     SqlConnPool();
     ~SqlConnPool(){ClosePool();};
 
+    static const int INIT_THREADS = 8; //并行建立连接的线程数
+    static const int CONNECT_RETRY = 3; //单个连接最多尝试次数
+    static const int RETRY_BASE_MS = 100; //重试退避的起始时间，每次翻倍
+    static const int MAX_BACKOFF_MS = 5000; //按需增长失败后最长的退避时间
+
+    struct StmtCache {
+        std::unordered_map<std::string, MYSQL_STMT*> stmts; //SQL文本 -> 语句
+    };
+
+    //每个连接一个槽，槽的个数在Init时按最大连接数定好，之后不再变
+    //取连接：先试本线程上次用过的槽（连接和它的语句缓存都是热的），再从无锁空闲栈弹，再扫一遍所有槽，
+    //还没有就按需增长，最后才在条件变量上等
+    enum SlotState { SLOT_EMPTY, SLOT_FREE, SLOT_BUSY };
+    struct Slot {
+        std::atomic<int> state; //SlotState，取连接就是CAS FREE -> BUSY
+        std::atomic<bool> inList; //是否在空闲栈里，保证同一个槽不会被压栈两次
+        std::atomic<uint32_t> next; //空闲栈中下一个槽的下标+1，0表示栈底
+        MYSQL* conn; //state从EMPTY变成别的值之前写好，指向handle
+        MYSQL handle; //连接句柄放在槽里，断线后原地重连，持有者手里的指针不变
+        StmtCache stmts; //只被持有该连接的线程访问
+        char pad[64]; //和下一个槽的原子变量隔开至少一个缓存行（C++11的new[]不保证alignas(64)）
+    };
+
+    bool Connect_(MYSQL* handle, int attempts); //按保存的参数在handle上打开连接，失败时退避重试
+    bool Reconnect_(MYSQL* conn); //连接断开后在原句柄上重连一次
+    int OpenParallel_(int n); //并行打开n个连接，返回成功的个数
+    MYSQL* Grow_(); //按需多开一个连接直接返回给调用者
+    int ReserveSlot_(); //占一个空槽放新连接，返回下标
+    MYSQL* TryAcquire_(); //不阻塞地取一个空闲连接
+    bool TakeSlot_(uint32_t i); //CAS FREE -> BUSY
+    void Push_(uint32_t i); //空闲槽压栈
+    int Pop_(); //弹出一个槽下标，栈空返回-1
+    Slot* SlotOf_(MYSQL* conn);
+    void Record_(uint64_t waitUs);
+
+    static void CloseStmts_(StmtCache& cache);
+    StmtCache& CacheOf_(MYSQL* conn);
+    MYSQL_STMT* Execute_(MYSQL* conn, const char* sql, MYSQL_BIND* params, MYSQL_BIND* result,
+                         unsigned int* errOut = nullptr);//执行并缓存结果，失败返回nullptr，错误码写进errOut
+
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> freeHead_; //空闲栈顶：高32位是版本号（防ABA），低32位是槽下标+1
+    static thread_local int hint_; //本线程上次拿到的槽
+
+    std::string host_, user_, passwd_, dbName_; //按需增长时用的连接参数
+    int port_;
     int max_CONN_SIZE; //最大连接数
-    std::queue<MYSQL*> conn_queue; //连接队列
-    std::mutex mtx; //互斥锁
-    sem_t sem; //信号量
+    std::atomic<int> opened_; //已经打开（含正在打开）的连接数
+    std::chrono::steady_clock::time_point nextGrow_; //按需增长失败后，到这个时间之前不再尝试，由mtx保护
+    int growBackoffMs_;
+
+    std::mutex mtx; //互斥锁，只用在阻塞等待和按需增长的慢路径上
+    std::condition_variable cond_;
+    std::atomic<int> waiters_; //在cond_上等的线程数，为0时FreeConn不用加锁通知
+    std::atomic<uint64_t> waitHist_[WAIT_BUCKETS];
+    std::atomic<uint64_t> timeouts_;
 };
 
 // RAII类，构造函数获取连接，析构函数释放连接
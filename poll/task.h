@@ -0,0 +1,181 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <type_traits>
+#include <assert.h>
+
+//Task内联存储的字节数，可以在编译选项里用-DTASK_INLINE_SIZE=...调整
+#ifndef TASK_INLINE_SIZE
+#define TASK_INLINE_SIZE 64
+#endif
+
+// 只能移动的任务包装，替代std::function<void()>
+// 可调用对象直接放在对象内部的Size字节里，从不在堆上分配；放不下时编译报错，而不是悄悄去malloc
+// 可以装只能移动的对象（比如捕获了unique_ptr、std::promise的lambda），std::function装不了
+template<size_t Size>
+class BasicTask {
+public:
+    static const size_t INLINE_SIZE = Size;
+
+    BasicTask() : ops_(nullptr) {}
+
+    template<typename F, typename = typename std::enable_if<
+                             !std::is_same<typename std::decay<F>::type, BasicTask>::value>::type>
+    BasicTask(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= Size, "callable does not fit in Task inline storage: capture less "
+                                          "(e.g. by pointer) or raise TASK_INLINE_SIZE");
+        static_assert(alignof(Fn) <= alignof(Storage), "callable is over-aligned for Task inline storage");
+        static_assert(std::is_move_constructible<Fn>::value, "Task needs a move-constructible callable");
+        new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &OpsFor<Fn>::ops;
+    }
+
+    BasicTask(BasicTask&& other) : ops_(nullptr) {
+        MoveFrom_(other);
+    }
+
+    BasicTask& operator=(BasicTask&& other) {
+        if(this != &other)
+        {
+            Reset();
+            MoveFrom_(other);
+        }
+        return *this;
+    }
+
+    BasicTask(const BasicTask&) = delete;
+    BasicTask& operator=(const BasicTask&) = delete;
+
+    ~BasicTask() {
+        Reset();
+    }
+
+    void operator()() {
+        assert(ops_);
+        ops_->invoke(&storage_);
+    }
+
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+
+    void Reset() {
+        if(ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    typedef typename std::aligned_storage<Size, alignof(std::max_align_t)>::type Storage;
+
+    //每种可调用类型一张函数表，对象里只存一个指针
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);//移动构造到dst，再析构src
+        void (*destroy)(void*);
+    };
+
+    template<typename Fn>
+    struct OpsFor {
+        static void Invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        static void Move(void* dst, void* src) {
+            Fn* from = static_cast<Fn*>(src);
+            new (dst) Fn(std::move(*from));
+            from->~Fn();
+        }
+        static void Destroy(void* p) { static_cast<Fn*>(p)->~Fn(); }
+        static const Ops ops;
+    };
+
+    void MoveFrom_(BasicTask& other) {
+        if(other.ops_)
+        {
+            other.ops_->move(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops* ops_;
+};
+
+template<size_t Size>
+template<typename Fn>
+const typename BasicTask<Size>::Ops BasicTask<Size>::OpsFor<Fn>::ops = {
+    &BasicTask<Size>::OpsFor<Fn>::Invoke, &BasicTask<Size>::OpsFor<Fn>::Move, &BasicTask<Size>::OpsFor<Fn>::Destroy};
+
+typedef BasicTask<TASK_INLINE_SIZE> Task;
+
+// 任务环形队列：容量是2的幂，满了才翻倍扩容，之后一直复用，稳定状态下入队出队都不分配内存
+// 每个任务可以带一个时间戳（比如入队时间），出队时一起拿出来
+// 不加锁，由使用者保护
+class TaskRing {
+public:
+    explicit TaskRing(size_t capacity = 1024) : head_(0), size_(0) {
+        size_t cap = 1;
+        while(cap < capacity)
+        {
+            cap <<= 1;
+        }
+        slots_.resize(cap);
+        stamps_.resize(cap);
+    }
+
+    template<typename F>
+    void Push(F&& f, int64_t stamp = 0) {
+        if(size_ == slots_.size())
+        {
+            Grow_();
+        }
+        size_t tail = (head_ + size_) & (slots_.size() - 1);
+        slots_[tail] = Task(std::forward<F>(f));
+        stamps_[tail] = stamp;
+        size_++;
+    }
+
+    Task Pop(int64_t* stamp = nullptr) {
+        assert(size_ > 0);
+        if(stamp)
+        {
+            *stamp = stamps_[head_];
+        }
+        Task task(std::move(slots_[head_]));
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        size_--;
+        return task;
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    void Grow_() {
+        std::vector<Task> slots(slots_.size() * 2);
+        std::vector<int64_t> stamps(slots_.size() * 2);
+        for(size_t i = 0; i < size_; i++)
+        {
+            slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+            stamps[i] = stamps_[(head_ + i) & (slots_.size() - 1)];
+        }
+        slots_.swap(slots);
+        stamps_.swap(stamps);
+        head_ = 0;
+    }
+
+    std::vector<Task> slots_;
+    std::vector<int64_t> stamps_;
+    size_t head_;
+    size_t size_;
+};
+
+#endif
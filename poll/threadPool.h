@@ -1,74 +1,759 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 #include <functional>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <iterator>
+#include <type_traits>
+#include <cstdio>
 #include <assert.h>
+#include "task.h"
+#include "placement.h"
+#include "histogram.h"
 
 class ThreadPool {
     public:
+        //优先级通道：处理请求的任务走FOREGROUND，日志压缩、缓存刷新这类后台活走BACKGROUND，不会排在它们后面
+        enum Lane {
+            FOREGROUND = 0,
+            BACKGROUND = 1,
+            LANES = 2
+        };
+
+        //DRAIN：把已经提交的任务做完再退出；CANCEL：丢掉还没开始的任务（它们的future会抛broken_promise），只等正在跑的做完
+        enum ShutdownMode {
+            DRAIN,
+            CANCEL
+        };
+
+        //一个工作线程实际放在哪：所属的域、NUMA节点（-1表示不知道）、绑核后读回来的亲和性
+        struct WorkerInfo {
+            int domain;
+            int node;
+            std::string cpus;
+        };
+
+        //GetStats()拿到的快照：排队深度、从入队到开始执行的等待时间和执行时间的分布（纳秒）、每个线程忙和闲的时间
+        //计数都是各个工作线程自己写自己的，拿快照时才汇总；退出了的线程的计数并进总数里，不再单列
+        struct Stats {
+            struct Worker {
+                WorkerInfo info;
+                uint64_t tasks;
+                uint64_t stolen;// 从别的域拿来的任务数
+                uint64_t busyNs;// 执行任务的时间
+                uint64_t idleNs;// 没任务、找任务和睡着的时间
+                uint64_t aliveNs;// 线程启动到现在
+            };
+            int threads = 0;
+            size_t queueDepth = 0;
+            size_t laneDepth[LANES] = {};
+            uint64_t tasks = 0;// 所有线程（包括已经退出的）执行过的任务数
+            LogHistogram waitNs;
+            LogHistogram runNs;
+            std::vector<Worker> workers;
+
+            //一行摘要，给统计接口或者定期打日志用
+            std::string ToString() const
+            {
+                char line[512];
+                snprintf(line, sizeof(line),
+                         "threads=%d queued=%zu(fg %zu bg %zu) tasks=%llu wait_us p50=%.1f p99=%.1f max=%.1f "
+                         "run_us p50=%.1f p99=%.1f max=%.1f util=",
+                         threads, queueDepth, laneDepth[FOREGROUND], laneDepth[BACKGROUND], (unsigned long long)tasks,
+                         waitNs.Percentile(0.5) / 1e3, waitNs.Percentile(0.99) / 1e3, waitNs.Max() / 1e3,
+                         runNs.Percentile(0.5) / 1e3, runNs.Percentile(0.99) / 1e3, runNs.Max() / 1e3);
+                std::string text(line);
+                for(size_t i = 0; i < workers.size(); i++)
+                {
+                    snprintf(line, sizeof(line), "%s%d%%", i ? "," : "",
+                             workers[i].aliveNs ? static_cast<int>(workers[i].busyNs * 100 / workers[i].aliveNs) : 0);
+                    text += line;
+                }
+                return text;
+            }
+        };
+
         ThreadPool() = default;// 默认构造函数
         ThreadPool(ThreadPool &&) = default;
         // 尽量用make_shared代替new，如果通过new再传递给shared_ptr，内存是不连续的，会造成内存碎片化
-        explicit ThreadPool(int threadCount=10) : pool_(std::make_shared<Pool>()){   //创建了一个指向 Pool 结构体的智能指针，并将其赋值给 pool_ 成员变量。
-                                                                                    //make_shared:传递右值，功能是在动态内存中分配一个对象并初始化它，返回指向此对象的shared_ptr
-                 assert(threadCount > 0);
-                 for(int i = 0; i < threadCount; i++) {
-                        std::thread([this]() {
-                            std::unique_lock<std::mutex> locker(pool_->mutex_);
-                            while(true){
-                             if(!pool_->taskQueue_.empty())
-                             {
-                                auto task =std::move(pool_->taskQueue_.front());
-                                pool_->taskQueue_.pop();
-                                locker.unlock();// 因为已经把任务取出来了，所以可以提前解锁了
-                                task();
-                                locker.lock();// 马上又要取任务了，上锁
-                             }else if(pool_->isClosed_){
-                                break;//如果线程池已关闭，则退出循环；
-                             }else{
-                                pool_->cond_.wait(locker);//否则，线程通过条件变量`cond_`等待新任务的到来。
-                             }         //当任务队列为空时，线程通过cond_.wait(locker) 挂起，并自动释放锁。
-                                       //当新任务被添加时（通过 AddTask），调用 cond_.notify_one() 唤醒一个线程，该线程重新获取锁并处理任务。
-                            }
-                        }).detach(); //线程创建后被分离（`detach()`），意味着主线程不会等待这些工作线程结束。
-                 }
+        explicit ThreadPool(int threadCount=10) : ThreadPool(threadCount, threadCount) {}//固定线程数
+        ThreadPool(int threadCount, const Placement& placement)
+            : ThreadPool(threadCount, threadCount, 30000, 5, placement) {}
 
+        //弹性线程池：常驻minThreads个线程，积压的任务比线程还多、或者队首任务等了growAfterMs还没人取时加线程，最多maxThreads个；
+        //多出来的线程空闲idleMs没有任务就退出
+        //placement决定线程绑到哪些核上：每个域（一般是一个NUMA节点）一个任务队列，线程轮流分到各个域，
+        //优先做本域的任务，本域没有了再去别的域拿；提交的任务进提交线程所在的域
+        ThreadPool(int minThreads, int maxThreads, int idleMs = 30000, int growAfterMs = 5,
+                   const Placement& placement = Placement())
+            : pool_(std::make_shared<Pool>()){   //创建了一个指向 Pool 结构体的智能指针，并将其赋值给 pool_ 成员变量。
+                                                 //make_shared:传递右值，功能是在动态内存中分配一个对象并初始化它，返回指向此对象的shared_ptr
+                 assert(minThreads > 0 && maxThreads >= minThreads);
+                 pool_->placement_ = placement;
+                 pool_->minThreads_ = minThreads;
+                 pool_->maxThreads_ = maxThreads;
+                 pool_->idleTimeout_ = std::chrono::milliseconds(idleMs);
+                 pool_->growAfter_ = std::chrono::milliseconds(growAfterMs);
+                 pool_->lastPop_ = NowNs_();
+                 for(size_t d = 0; d < placement.Domains(); d++) {
+                        //临时绑到这个域的核上再分配，队列的内存第一次写在这个节点上，物理页就分在这个节点
+                        Placement::ScopedBind bind(placement.DomainAt(d).cpus);
+                        pool_->nodes_.emplace_back(new Node);
+                        pool_->nodes_.back()->elastic_ = minThreads != maxThreads;
+                 }
+                 for(int i = 0; i < minThreads; i++) {
+                        size_t d = i % pool_->nodes_.size();
+                        std::lock_guard<std::mutex> locker(pool_->nodes_[d]->mutex_);
+                        std::lock_guard<std::mutex> ctl(pool_->ctlMtx_);
+                        Spawn_(pool_, d);
+                 }
         }
         
         ~ThreadPool(){
-            if(pool_)
+            Shutdown(DRAIN);
+        }
+
+        //停止接收新任务，按mode处理剩下的任务，等所有工作线程退出；返回丢掉的任务数
+        //可以重复调用；在本池的任务里调用时不会等自己
+        size_t Shutdown(ShutdownMode mode = DRAIN)
+        {
+            if(!pool_)//被移走的pool_是空的
             {
-                std::unique_lock<std::mutex> locker(pool_->mutex_);//这个作用域内的代码被互斥锁保
-                pool_->isClosed_=true;                                                   // ...操作共享资源...                                                       // 离开作用域时自动释放锁
+                return 0;
             }
-            pool_->cond_.notify_all();//使它们检查关闭标志并退出循环。
+            std::vector<TaskRing> dropped;
+            size_t droppedCount = 0;
+            pool_->isClosed_.store(true);
+            for(auto& node : pool_->nodes_)
+            {
+                std::unique_lock<std::mutex> locker(node->mutex_);//这个作用域内的代码被互斥锁保
+                if(mode == CANCEL)
+                {
+                    for(int i = 0; i < LANES; i++)
+                    {
+                        dropped.push_back(TaskRing(1));
+                        std::swap(dropped.back(), node->lanes_[i]);//任务析构放到锁外面
+                    }
+                    droppedCount += node->pending_;
+                    if(node->elastic_)
+                    {
+                        pool_->pendingTotal_.fetch_sub(node->pending_, std::memory_order_relaxed);
+                    }
+                    node->pending_ = 0;
+                }
+                node->cond_.notify_all();//使它们检查关闭标志并退出循环
+            }
+            std::vector<std::thread> threads;
+            {
+                std::lock_guard<std::mutex> locker(pool_->ctlMtx_);
+                threads.swap(pool_->threads_);
+                pool_->retired_.clear();
+            }
+            for(std::thread& thread : threads)
+            {
+                if(thread.get_id() == std::this_thread::get_id())
+                {
+                    thread.detach();//任务里关闭自己所在的池，不能join自己；线程手里有Pool的shared_ptr
+                }
+                else
+                {
+                    thread.join();
+                }
+            }
+            return droppedCount;
         }
 
+        //池已关闭时返回false，任务不会执行
         template<typename T>
-        void AddTask(T&& task)
+        bool AddTask(T&& task, Lane lane = FOREGROUND)
+        {
+            assert(lane >= 0 && lane < LANES);
+            size_t d = PickNode_(pool_.get());
+            Node& node = *pool_->nodes_[d];
+            int64_t now = NowNs_();
+            std::vector<std::thread> reaped;
+            bool kick = false;
+            {
+                std::unique_lock<std::mutex> locker(node.mutex_);
+                if(pool_->isClosed_.load())
+                {
+                    return false;
+                }
+                node.lanes_[lane].Push(std::forward<T>(task), now);//放进环形队列预先分配好的槽里，不分配内存；带上入队时间
+                node.pending_++;
+                if(node.elastic_)//固定大小的池不用判断要不要加线程，不碰这个全池共享的计数
+                {
+                    pool_->pendingTotal_.fetch_add(1, std::memory_order_relaxed);
+                }
+                kick = node.idle_.load(std::memory_order_relaxed) == 0;
+                node.Wake(1);
+                Grow_(pool_, d, &reaped);
+            }
+            if(kick)
+            {
+                Kick_(pool_.get(), d, 1);
+            }
+            Join_(reaped);
+            return true;
+        }
+
+        //一次加锁放进一批任务，最后按任务数叫醒空闲线程，不用每个任务加锁通知一次
+        //元素会被移走，所以可以放只能移动的可调用对象（比如std::vector<Task>）
+        template<typename Iter>
+        bool AddTasks(Iter first, Iter last, Lane lane = FOREGROUND)
+        {
+            assert(lane >= 0 && lane < LANES);
+            size_t d = PickNode_(pool_.get());
+            Node& node = *pool_->nodes_[d];
+            size_t n = 0, idle = 0;
+            int64_t now = NowNs_();
+            std::vector<std::thread> reaped;
+            {
+                std::unique_lock<std::mutex> locker(node.mutex_);
+                if(pool_->isClosed_.load())
+                {
+                    return false;
+                }
+                for(; first != last; ++first)
+                {
+                    node.lanes_[lane].Push(std::move(*first), now);
+                    n++;
+                }
+                node.pending_ += n;
+                if(node.elastic_)
+                {
+                    pool_->pendingTotal_.fetch_add(n, std::memory_order_relaxed);
+                }
+                idle = node.idle_.load(std::memory_order_relaxed);
+                node.Wake(n);
+                Grow_(pool_, d, &reaped);
+            }
+            if(n > idle)
+            {
+                Kick_(pool_.get(), d, n - idle);
+            }
+            Join_(reaped);
+            return true;
+        }
+
+        template<typename Range>
+        bool AddTasks(Range&& range, Lane lane = FOREGROUND)
+        {
+            return AddTasks(std::begin(range), std::end(range), lane);
+        }
+
+        //提交任务并拿到结果；任务抛出的异常会在future.get()时重新抛出；池已关闭时future.get()抛broken_promise
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> Submit(F&& func, Lane lane = FOREGROUND)
+        {
+            typedef typename std::result_of<F()>::type R;
+            std::packaged_task<R()> task(std::forward<F>(func));//packaged_task只能移动，Task装得下
+            std::future<R> result = task.get_future();
+            AddTask(std::move(task), lane);
+            return result;
+        }
+
+        int ThreadCount() const
+        {
+            std::lock_guard<std::mutex> locker(pool_->ctlMtx_);
+            return pool_->live_;
+        }
+
+        size_t Pending() const
         {
-            std::unique_lock<std::mutex> locker(pool_->mutex_);
-            pool_->taskQueue_.emplace(std::forward<T>(task));
-            pool_->cond_.notify_one();
+            size_t pending = 0;
+            for(auto& node : pool_->nodes_)
+            {
+                std::lock_guard<std::mutex> locker(node->mutex_);
+                pending += node->pending_;
+            }
+            return pending;
         }
 
+        std::vector<WorkerInfo> Workers() const
+        {
+            std::lock_guard<std::mutex> locker(pool_->ctlMtx_);
+            std::vector<WorkerInfo> workers;
+            for(const WorkerSlot& worker : pool_->workers_)
+            {
+                workers.push_back(worker.info);
+            }
+            return workers;
+        }
 
+        Stats GetStats() const
+        {
+            Stats stats;
+            for(auto& node : pool_->nodes_)
+            {
+                std::lock_guard<std::mutex> locker(node->mutex_);
+                for(int i = 0; i < LANES; i++)
+                {
+                    stats.laneDepth[i] += node->lanes_[i].size();
+                }
+                stats.queueDepth += node->pending_;
+            }
+            int64_t now = NowNs_();
+            std::lock_guard<std::mutex> locker(pool_->ctlMtx_);
+            const WorkerStats& retired = pool_->retiredStats_;
+            stats.threads = pool_->live_;
+            stats.tasks = retired.tasks.load(std::memory_order_relaxed);
+            stats.waitNs = retired.waitNs;
+            stats.runNs = retired.runNs;
+            for(const WorkerSlot& slot : pool_->workers_)
+            {
+                const WorkerStats& ws = *slot.stats;
+                Stats::Worker worker;
+                worker.info = slot.info;
+                worker.tasks = ws.tasks.load(std::memory_order_relaxed);
+                worker.stolen = ws.stolen.load(std::memory_order_relaxed);
+                worker.busyNs = ws.busyNs.load(std::memory_order_relaxed);
+                worker.idleNs = ws.idleNs.load(std::memory_order_relaxed);
+                int64_t idleSince = ws.idleSince.load(std::memory_order_relaxed);
+                if(idleSince > 0 && now > idleSince)
+                {
+                    worker.idleNs += now - idleSince;
+                }
+                worker.aliveNs = now - ws.startNs;
+                stats.workers.push_back(worker);
+                stats.tasks += worker.tasks;
+                stats.waitNs.Merge(ws.waitNs);
+                stats.runNs.Merge(ws.runNs);
+            }
+            return stats;
+        }
+
+        std::string PlacementInfo() const
+        {
+            return pool_->placement_.Describe();
+        }
 
     private:
-        struct Pool{
+        typedef std::chrono::steady_clock Clock;
+
+        //前台一直有任务时，每连续取这么多个前台任务，就插一个后台任务，后台不会被饿死
+        static const int BACKGROUND_SHARE = 16;
+
+        static int64_t NowNs_()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        }
+
+        // 一个工作线程的计数，只有它自己写；由它自己分配，绑核之后分配的内存在本节点上
+        // 前后各垫一个缓存行，不和别的线程的数据共享缓存行（C++11的new不保证按alignas对齐）
+        struct WorkerStats {
+            char padFront_[64];
+            std::atomic<uint64_t> tasks{0};
+            std::atomic<uint64_t> stolen{0};
+            std::atomic<uint64_t> busyNs{0};
+            std::atomic<uint64_t> idleNs{0};
+            std::atomic<int64_t> idleSince{0};// 正在空闲时是开始空闲的时间，快照把这一段也算上
+            int64_t startNs = 0;
+            LogHistogram waitNs;
+            LogHistogram runNs;
+            char padBack_[64];
+
+            static void Bump(std::atomic<uint64_t>& counter, uint64_t delta) {//单写者，不用原子加
+                counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            }
+
+            //调用方持有ctlMtx_，把退出的线程的计数并进总数
+            void Merge(const WorkerStats& other) {
+                Bump(tasks, other.tasks.load(std::memory_order_relaxed));
+                Bump(stolen, other.stolen.load(std::memory_order_relaxed));
+                Bump(busyNs, other.busyNs.load(std::memory_order_relaxed));
+                Bump(idleNs, other.idleNs.load(std::memory_order_relaxed));
+                waitNs.Merge(other.waitNs);
+                runNs.Merge(other.runNs);
+            }
+        };
+
+        struct WorkerSlot {
+            std::thread::id id;
+            WorkerInfo info;
+            WorkerStats* stats;
+        };
+
+        //一个域的任务队列和在上面等的线程
+        struct Node{
             std::mutex mutex_;
             std::condition_variable cond_;
-            bool isClosed_ = false;
-            std::queue<std::function<void()>> taskQueue_;// 任务队列
+            TaskRing lanes_[LANES];// 每个优先级一个任务队列
+            size_t pending_ = 0;// 所有通道里的任务总数
+            std::atomic<size_t> idle_{0};// 没活干、准备等或者正在cond_上等的线程数，只在持有mutex_时修改
+            int streak_ = 0;// 后台有任务时连续取了多少个前台任务
+            uint64_t kicks_ = 0;// 别的域叫这个域的空闲线程过去帮忙的次数
+            size_t spawned_ = 0;// 一共在这个域起过多少个线程，用来轮流选核
+            bool elastic_ = false;
+            char pad_[64];// 不同域的锁不共享缓存行
+
+            //调用方持有mutex_，且pending_ > 0；stamp拿到入队时间
+            Task Pop(int64_t* stamp) {
+                pending_--;
+                if(lanes_[FOREGROUND].empty())
+                {
+                    streak_ = 0;
+                    return lanes_[BACKGROUND].Pop(stamp);
+                }
+                if(!lanes_[BACKGROUND].empty() && ++streak_ >= BACKGROUND_SHARE)
+                {
+                    streak_ = 0;
+                    return lanes_[BACKGROUND].Pop(stamp);
+                }
+                return lanes_[FOREGROUND].Pop(stamp);
+            }
+
+            //调用方持有mutex_；新来n个任务，最多叫醒n个空闲线程
+            void Wake(size_t n) {
+                size_t idle = idle_.load(std::memory_order_relaxed);
+                if(n >= idle)
+                {
+                    if(idle > 0)
+                    {
+                        cond_.notify_all();
+                    }
+                    return;
+                }
+                for(size_t i = 0; i < n; i++)
+                {
+                    cond_.notify_one();
+                }
+            }
+        };
+
+        struct Pool{
+            Placement placement_;
+            std::vector<std::unique_ptr<Node>> nodes_;// 构造后不再变
+            std::atomic<bool> isClosed_{false};
+            std::atomic<size_t> idleTotal_{0};// 各个域idle_的和
+            std::atomic<size_t> pendingTotal_{0};// 各个域pending_的和，只有弹性池才维护（Grow_用）
+            std::atomic<int64_t> lastPop_{0};// 上次有线程取走任务的时间（纳秒），只有弹性池才更新
+            std::atomic<size_t> next_{0};// 外部线程提交时轮流选域
+
+            std::mutex ctlMtx_;// 保护下面这些；加锁顺序：域的mutex_ -> ctlMtx_
+            int minThreads_ = 0;
+            int maxThreads_ = 0;
+            std::atomic<int> live_{0};// 还在跑的工作线程数，只在持有ctlMtx_时修改
+            Clock::duration idleTimeout_;
+            Clock::duration growAfter_;
+            std::vector<std::thread> threads_;
+            std::vector<std::thread::id> retired_;// 空闲超时退出了、还没join的线程
+            std::vector<WorkerSlot> workers_;
+            WorkerStats retiredStats_;// 已经退出的线程的计数之和
         };
+
+        struct Current {
+            Pool* pool;
+            size_t node;
+        };
+        static Current& Current_() {//当前线程是哪个池哪个域的工作线程；头文件里的类没法直接定义thread_local静态成员
+            static thread_local Current current = {nullptr, 0};
+            return current;
+        }
+
+        //工作线程提交的任务进自己的域；外部线程按所在的核找域，找不到就轮流放
+        static size_t PickNode_(Pool* pool)
+        {
+            size_t n = pool->nodes_.size();
+            if(n == 1)
+            {
+                return 0;
+            }
+            Current& current = Current_();
+            if(current.pool == pool)
+            {
+                return current.node;
+            }
+            int d = pool->placement_.DomainOfCurrentCpu();
+            if(d >= 0)
+            {
+                return d;
+            }
+            return pool->next_.fetch_add(1, std::memory_order_relaxed) % n;
+        }
+
+        //d域的空闲线程不够做新来的n个任务，叫别的域的空闲线程过来拿
+        //和Run_里先idleTotal_++再去别的域找任务配对：要么这里看到它空闲，要么它看到新任务
+        static void Kick_(Pool* pool, size_t d, size_t n)
+        {
+            if(pool->nodes_.size() == 1)
+            {
+                return;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(pool->idleTotal_.load(std::memory_order_relaxed) == 0)
+            {
+                return;
+            }
+            for(size_t i = 1; i < pool->nodes_.size() && n > 0; i++)
+            {
+                Node& other = *pool->nodes_[(d + i) % pool->nodes_.size()];
+                if(other.idle_.load(std::memory_order_relaxed) == 0)
+                {
+                    continue;
+                }
+                std::lock_guard<std::mutex> locker(other.mutex_);
+                size_t idle = other.idle_.load(std::memory_order_relaxed);
+                other.kicks_++;
+                other.Wake(n);
+                n -= idle < n ? idle : n;
+            }
+        }
+
+        //调用方持有d域的mutex_和ctlMtx_
+        static void Spawn_(const std::shared_ptr<Pool>& pool, size_t d)
+        {
+            Node& node = *pool->nodes_[d];
+            std::vector<int> cpus = pool->placement_.CpusFor(d, node.spawned_++);
+            pool->live_++;
+            pool->threads_.emplace_back([pool, d, cpus]() { Run_(pool, d, cpus); });//持有Pool的shared_ptr，在任务里关闭自己所在的池时线程会被分离
+        }
+
+        //调用方持有d域的mutex_；按整个池算：空闲的线程够用就不加（别的域的空闲线程由Kick_叫过来），
+        //积压比线程数还深时加到比积压多一个，一段时间没人取任务（线程都卡在长任务上）时给每个积压的任务加一个线程；
+        //新线程放在d域，自己域没活时会去别的域拿
+        //顺便把已经退出的线程从threads_里拿出来，交给调用方在锁外join
+        static void Grow_(const std::shared_ptr<Pool>& pool, size_t d, std::vector<std::thread>* reaped)
+        {
+            if(!pool->nodes_[d]->elastic_)
+            {
+                return;
+            }
+            size_t idle = pool->idleTotal_.load(std::memory_order_relaxed);
+            size_t pending = pool->pendingTotal_.load(std::memory_order_relaxed);
+            if(idle >= pending)
+            {
+                return;
+            }
+            size_t live = pool->live_.load(std::memory_order_relaxed);
+            size_t backlog = pending - idle;
+            size_t target = backlog + 1;
+            if(backlog < live)
+            {
+                std::chrono::nanoseconds sinceLastPop(NowNs_() - pool->lastPop_.load(std::memory_order_relaxed));
+                if(sinceLastPop < pool->growAfter_)
+                {
+                    return;
+                }
+                target = live + backlog;
+            }
+            std::lock_guard<std::mutex> locker(pool->ctlMtx_);
+            if(target > static_cast<size_t>(pool->maxThreads_))
+            {
+                target = pool->maxThreads_;
+            }
+            Reap_(pool.get(), reaped);
+            while(static_cast<size_t>(pool->live_) < target)
+            {
+                Spawn_(pool, d);
+            }
+        }
+
+        //调用方持有node.mutex_，且node.pending_ > 0；stamp拿到入队时间，now是取出的时间
+        static Task Take_(Pool* pool, Node& node, int64_t* stamp, int64_t now)
+        {
+            if(node.elastic_)
+            {
+                pool->pendingTotal_.fetch_sub(1, std::memory_order_relaxed);
+                pool->lastPop_.store(now, std::memory_order_relaxed);
+            }
+            return node.Pop(stamp);
+        }
+
+        //执行一个任务并记下等待和执行时间，返回结束的时间
+        static int64_t Execute_(WorkerStats* stats, Task& task, int64_t stamp, int64_t start)
+        {
+            task();
+            task.Reset();// 在锁外析构
+            int64_t end = NowNs_();
+            stats->waitNs.Add(start > stamp ? start - stamp : 0);
+            stats->runNs.Add(end - start);
+            WorkerStats::Bump(stats->busyNs, end - start);
+            WorkerStats::Bump(stats->tasks, 1);
+            return end;
+        }
+
+        //调用方持有ctlMtx_
+        static void Reap_(Pool* pool, std::vector<std::thread>* reaped)
+        {
+            for(const std::thread::id& id : pool->retired_)
+            {
+                for(size_t i = 0; i < pool->threads_.size(); i++)
+                {
+                    if(pool->threads_[i].get_id() == id)
+                    {
+                        reaped->push_back(std::move(pool->threads_[i]));
+                        pool->threads_[i] = std::move(pool->threads_.back());
+                        pool->threads_.pop_back();
+                        break;
+                    }
+                }
+            }
+            pool->retired_.clear();
+        }
+
+        static void Join_(std::vector<std::thread>& reaped)
+        {
+            for(std::thread& thread : reaped)
+            {
+                thread.join();
+            }
+        }
+
+        //本域没任务时去别的域拿一个
+        static Task Steal_(Pool* pool, size_t d, int64_t* stamp, int64_t* now)
+        {
+            for(size_t i = 1; i < pool->nodes_.size(); i++)
+            {
+                Node& other = *pool->nodes_[(d + i) % pool->nodes_.size()];
+                std::lock_guard<std::mutex> locker(other.mutex_);
+                if(other.pending_ > 0)
+                {
+                    *now = NowNs_();
+                    return Take_(pool, other, stamp, *now);
+                }
+            }
+            return Task();
+        }
+
+        //调用方持有ctlMtx_；计数并进总数后释放
+        static void Unregister_(Pool* pool)
+        {
+            for(size_t i = 0; i < pool->workers_.size(); i++)
+            {
+                if(pool->workers_[i].id == std::this_thread::get_id())
+                {
+                    pool->retiredStats_.Merge(*pool->workers_[i].stats);
+                    delete pool->workers_[i].stats;
+                    pool->workers_[i] = pool->workers_.back();
+                    pool->workers_.pop_back();
+                    break;
+                }
+            }
+        }
+
+        static void Run_(std::shared_ptr<Pool> pool, size_t d, std::vector<int> cpus)
+        {
+            Placement::Bind(cpus);//先绑核再分配线程自己的东西（栈、malloc的线程缓存、计数），它们就落在本节点
+            WorkerStats* stats = new WorkerStats;
+            stats->startNs = NowNs_();
+            {
+                WorkerSlot slot;
+                slot.id = std::this_thread::get_id();
+                slot.info.domain = static_cast<int>(d);
+                slot.info.node = pool->placement_.DomainAt(d).node;
+                slot.info.cpus = Placement::FormatCpuList(Placement::CurrentAffinity());
+                slot.stats = stats;
+                std::lock_guard<std::mutex> locker(pool->ctlMtx_);
+                pool->workers_.push_back(slot);
+            }
+            Current& current = Current_();
+            current.pool = pool.get();
+            current.node = d;
+            Node& node = *pool->nodes_[d];
+            bool shared = pool->nodes_.size() > 1;
+
+            std::unique_lock<std::mutex> locker(node.mutex_);
+            int64_t lastEnd = 0;// 上一个任务刚做完就接着取时，用它的结束时间当下一个的开始时间，少读一次时钟
+            while(true){
+             if(node.pending_ > 0)
+             {
+                int64_t stamp;
+                int64_t start = lastEnd ? lastEnd : NowNs_();
+                Task task = Take_(pool.get(), node, &stamp, start);
+                locker.unlock();// 因为已经把任务取出来了，所以可以提前解锁了
+                lastEnd = Execute_(stats, task, stamp, start);
+                locker.lock();// 马上又要取任务了，上锁
+                continue;
+             }
+             lastEnd = 0;
+             //准备睡：先登记空闲，再去别的域找一遍，和Kick_配对，不会漏掉刚放进别的域的任务
+             //关闭标志在找之前读：提交时在域的锁里看到没关闭的任务，这一遍一定能找到，看到关闭并且没找到就可以退出
+             bool closed = pool->isClosed_.load();
+             uint64_t kicks = node.kicks_;
+             int64_t idleStart = NowNs_();
+             stats->idleSince.store(idleStart, std::memory_order_relaxed);
+             node.idle_.fetch_add(1, std::memory_order_relaxed);
+             pool->idleTotal_.fetch_add(1, std::memory_order_seq_cst);
+             if(shared)
+             {
+                locker.unlock();
+                int64_t stamp, start;
+                Task task = Steal_(pool.get(), d, &stamp, &start);
+                if(task)
+                {
+                    node.idle_.fetch_sub(1, std::memory_order_relaxed);
+                    pool->idleTotal_.fetch_sub(1, std::memory_order_relaxed);
+                    stats->idleSince.store(0, std::memory_order_relaxed);
+                    WorkerStats::Bump(stats->idleNs, start - idleStart);
+                    WorkerStats::Bump(stats->stolen, 1);
+                    Execute_(stats, task, stamp, start);
+                    locker.lock();
+                    continue;
+                }
+                locker.lock();
+             }
+             bool retire = false;
+             if(!closed && node.pending_ == 0)
+             {
+                if(!node.elastic_ || pool->live_ <= pool->minThreads_)//live_只在这里粗看一眼，真退出前会在ctlMtx_里再确认
+                {
+                    //常驻线程通过条件变量`cond_`等待新任务的到来，挂起时自动释放锁
+                    while(node.pending_ == 0 && node.kicks_ == kicks && !pool->isClosed_.load(std::memory_order_relaxed))
+                    {
+                        node.cond_.wait(locker);
+                    }
+                }
+                else
+                {
+                    //多出来的线程：空闲超时还没有任务就退出，由下一次加线程或者Shutdown来join
+                    Clock::time_point deadline = Clock::now() + pool->idleTimeout_;
+                    bool timeout = false;
+                    while(node.pending_ == 0 && node.kicks_ == kicks && !pool->isClosed_.load(std::memory_order_relaxed) && !timeout)
+                    {
+                        timeout = node.cond_.wait_until(locker, deadline) == std::cv_status::timeout;
+                    }
+                    retire = timeout && node.pending_ == 0 && !pool->isClosed_.load(std::memory_order_relaxed);
+                }
+             }
+             node.idle_.fetch_sub(1, std::memory_order_relaxed);
+             pool->idleTotal_.fetch_sub(1, std::memory_order_relaxed);
+             stats->idleSince.store(0, std::memory_order_relaxed);
+             WorkerStats::Bump(stats->idleNs, NowNs_() - idleStart);
+             if(retire)
+             {
+                std::lock_guard<std::mutex> ctl(pool->ctlMtx_);
+                if(pool->live_ > pool->minThreads_)
+                {
+                    pool->live_--;
+                    pool->retired_.push_back(std::this_thread::get_id());
+                    Unregister_(pool.get());
+                    current.pool = nullptr;
+                    return;
+                }
+             }
+             if(closed && node.pending_ == 0)
+             {
+                break;//如果线程池已关闭，并且本域和别的域都没有任务了，则退出循环；
+             }
+            }
+            std::lock_guard<std::mutex> ctl(pool->ctlMtx_);
+            pool->live_--;
+            Unregister_(pool.get());
+            current.pool = nullptr;
+        }
+
         std::shared_ptr<Pool> pool_; // 共享指针，线程安全
 };
 
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,133 @@
+#include "userbatcher.h"
+#include <unordered_map>
+#include <unordered_set>
+
+UserBatcher::UserBatcher() : window_(0), maxBatch_(0), open_(nullptr), lookups_(0), batches_(0) {}
+
+UserBatcher* UserBatcher::Instance(){
+    static UserBatcher batcher;
+    return &batcher;
+}
+
+void UserBatcher::Init(int windowUs, int maxBatch){
+    std::lock_guard<std::mutex> locker(mtx_);
+    window_ = std::chrono::microseconds(windowUs > 0 ? windowUs : 0);
+    maxBatch_ = maxBatch > 0 ? maxBatch : 0;
+}
+
+int UserBatcher::LookupOne_(const std::string& user, std::string* passwd){
+    MYSQL* sql = nullptr;
+    SqlConnPool* pool = SqlConnPool::Instance();
+    SqlConnRAII raii(&sql, pool);
+    if(!sql)
+    {
+        return -1;
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    return pool->QueryUser(sql, user, passwd);
+}
+
+int UserBatcher::Lookup(const std::string& user, std::string* passwd){
+    lookups_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> locker(mtx_);
+    if(maxBatch_ <= 1)
+    {
+        locker.unlock();
+        return LookupOne_(user, passwd);
+    }
+
+    Waiter self;
+    self.user = &user;
+    self.passwd = passwd;
+    self.result = -1;
+    self.done = false;
+    if(open_)//有批次正在收人，加进去等领头者的结果
+    {
+        open_->waiters.push_back(&self);
+        if(open_->waiters.size() >= maxBatch_)
+        {
+            open_->closed = true;
+            open_ = nullptr;
+            full_.notify_all();
+        }
+        self.cond.wait(locker, [&self]{ return self.done; });
+        return self.result;
+    }
+
+    //自己当领头者，开一个新批次
+    Batch batch;
+    batch.waiters.reserve(maxBatch_);
+    batch.waiters.push_back(&self);
+    batch.closed = false;
+    open_ = &batch;
+    full_.wait_for(locker, window_, [&batch]{ return batch.closed; });
+    if(open_ == &batch)
+    {
+        open_ = nullptr;
+    }
+    locker.unlock();
+
+    Run_(batch.waiters);
+
+    locker.lock();
+    for(Waiter* w : batch.waiters)
+    {
+        w->done = true;
+        if(w != &self)
+        {
+            w->cond.notify_one();//持锁通知：跟随者拿到锁之前不会返回，它栈上的Waiter在这之前一直有效
+        }
+    }
+    return self.result;
+}
+
+void UserBatcher::Run_(std::vector<Waiter*>& waiters){
+    if(waiters.size() == 1)
+    {
+        Waiter* w = waiters[0];
+        w->result = LookupOne_(*w->user, w->passwd);
+        return;
+    }
+    //同一个用户名可能被同时登录好几次，只查一遍
+    std::vector<std::string> users;
+    std::unordered_set<std::string> seen;
+    for(Waiter* w : waiters)
+    {
+        if(seen.insert(*w->user).second)
+        {
+            users.push_back(*w->user);
+        }
+    }
+
+    MYSQL* sql = nullptr;
+    SqlConnPool* pool = SqlConnPool::Instance();
+    SqlConnRAII raii(&sql, pool);
+    if(!sql)
+    {
+        return;//结果保持-1
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    std::unordered_map<std::string, std::string> rows;
+    int count = pool->QueryUsers(sql, users, &rows);
+    if(count < 0)
+    {
+        return;
+    }
+    //QueryUsers和QueryUser都按字节比较用户名，按字节分发的结果和逐条查询一致
+    for(Waiter* w : waiters)
+    {
+        auto it = rows.find(*w->user);
+        if(it != rows.end())
+        {
+            w->result = 1;
+            if(w->passwd)
+            {
+                *w->passwd = it->second;
+            }
+        }
+        else
+        {
+            w->result = 0;
+        }
+    }
+}
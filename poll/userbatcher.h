@@ -0,0 +1,60 @@
+#ifndef USERBATCHER_H
+#define USERBATCHER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <stdint.h>
+#include "sqlconnpool.h"
+
+// 登录查询合并：短时间窗口内到达的按用户名查密码请求合并成一条 WHERE username IN (...)，
+// 一次往返、一次借连接，查到的行再分发给各个等待的调用者
+// 没有单独的线程：第一个到达的请求当领头者，等满window或者攒够maxBatch个就关门，自己去查数据库，
+// 后到的请求加入当前批次后阻塞，直到领头者把结果填好
+// 用延迟换吞吐，只在登录高峰时有意义；默认关闭，Lookup直接走SqlConnPool::QueryUser
+class UserBatcher {
+public:
+    static UserBatcher* Instance();
+
+    void Init(int windowUs, int maxBatch);//maxBatch<=1时关闭合并
+    bool Enabled() const { return maxBatch_ > 1; }
+
+    int Lookup(const std::string& user, std::string* passwd);//和QueryUser一样：找到返回1，没有返回0，出错返回-1
+
+    uint64_t Lookups() { return lookups_.load(std::memory_order_relaxed); }
+    uint64_t Batches() { return batches_.load(std::memory_order_relaxed); }//实际发给数据库的查询数
+
+private:
+    UserBatcher();
+    ~UserBatcher() = default;
+
+    struct Waiter {
+        const std::string* user;
+        std::string* passwd;
+        int result;
+        bool done;//由mtx_保护
+        std::condition_variable cond;//领头者填好结果后单独唤醒
+    };
+    struct Batch {
+        std::vector<Waiter*> waiters;
+        bool closed;
+    };
+
+    int LookupOne_(const std::string& user, std::string* passwd);
+    void Run_(std::vector<Waiter*>& waiters);//不持锁执行，结果写进每个Waiter
+
+    std::chrono::microseconds window_;
+    size_t maxBatch_;
+
+    std::mutex mtx_;
+    std::condition_variable full_;//批次满了，叫醒领头者提前关门
+    Batch* open_;//正在收人的批次，在领头者的栈上，由mtx_保护
+
+    std::atomic<uint64_t> lookups_;
+    std::atomic<uint64_t> batches_;
+};
+
+#endif
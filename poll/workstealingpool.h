@@ -0,0 +1,351 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <assert.h>
+#include "task.h"
+
+// Chase-Lev工作窃取双端队列（Lê等人2013年给出的C11内存序版本）
+// 只有拥有者线程在底部Push/Pop（后进先出，缓存是热的），其他线程从顶部Steal（先进先出）
+// 满了按两倍扩容，旧数组可能还有窃取者在读，留到析构时再释放
+template<typename T>
+class WorkDeque {
+public:
+    explicit WorkDeque(int64_t capacity = 256) : top_(0), bottom_(0) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        Array* array = new Array(capacity);
+        arrays_.push_back(std::unique_ptr<Array>(array));
+        array_.store(array, std::memory_order_relaxed);
+    }
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    //只有拥有者调用
+    void Push(T* item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if(b - t > array->mask)
+        {
+            array = Grow_(array, t, b);
+        }
+        array->Put(b, item);
+        bottom_.store(b + 1, std::memory_order_release);//和Steal里读bottom_的acquire配对，任务内容对窃取者可见
+    }
+
+    //只有拥有者调用，空时返回nullptr
+    T* Pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if(t > b)//空的
+        {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = array->Get(b);
+        if(t == b)//最后一个，和窃取者抢
+        {
+            if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    //任何线程都可以调用，空或者抢输了返回nullptr
+    T* Steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if(t >= b)
+        {
+            return nullptr;
+        }
+        Array* array = array_.load(std::memory_order_acquire);
+        T* item = array->Get(t);
+        if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool Empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array {
+        int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> items;
+
+        explicit Array(int64_t capacity) : mask(capacity - 1), items(new std::atomic<T*>[capacity]) {}
+        T* Get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+        void Put(int64_t i, T* item) { items[i & mask].store(item, std::memory_order_relaxed); }
+    };
+
+    Array* Grow_(Array* old, int64_t t, int64_t b) {
+        Array* array = new Array((old->mask + 1) * 2);
+        for(int64_t i = t; i < b; i++)
+        {
+            array->Put(i, old->Get(i));
+        }
+        arrays_.push_back(std::unique_ptr<Array>(array));//只有拥有者改arrays_
+        array_.store(array, std::memory_order_release);
+        return array;
+    }
+
+    std::atomic<int64_t> top_;
+    char pad_[64];//窃取者改top_，拥有者改bottom_，分开缓存行
+    std::atomic<int64_t> bottom_;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+// 工作窃取线程池，接口和ThreadPool一样用AddTask提交
+// 每个工作线程有自己的WorkDeque：在工作线程里提交的任务进自己的队列，不和别人争锁；
+// 外部线程提交的任务进共享的注入队列。工作线程取任务的顺序：自己的队列 -> 注入队列（顺带搬一批到自己队列）->
+// 从随机位置开始挨个窃取别人的队列，都没有才在条件变量上睡
+// 析构时把已经提交的任务做完再退出
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int threadCount = 10) : pool_(std::make_shared<Pool>()) {
+        assert(threadCount > 0);
+        pool_->workers.reserve(threadCount);
+        for(int i = 0; i < threadCount; i++)
+        {
+            pool_->workers.emplace_back(new Worker);
+            pool_->workers.back()->rng = 0x9E3779B9u * (i + 1);
+        }
+        for(int i = 0; i < threadCount; i++)
+        {
+            std::shared_ptr<Pool> pool = pool_;
+            threads_.emplace_back([pool, i]() { Run_(pool.get(), i); });
+        }
+    }
+
+    WorkStealingPool(WorkStealingPool&&) = default;
+
+    ~WorkStealingPool() {
+        if(pool_)
+        {
+            {
+                std::lock_guard<std::mutex> locker(pool_->parkMtx);
+                pool_->isClosed = true;
+            }
+            pool_->parkCond.notify_all();
+        }
+        for(std::thread& thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    template<typename T>
+    void AddTask(T&& task) {
+        Task* item = new Task(std::forward<T>(task));
+        Pool* pool = pool_.get();
+        Current& current = Current_();
+        if(current.pool == pool)//本池的工作线程里提交，进自己的队列
+        {
+            pool->workers[current.index]->deque.Push(item);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> locker(pool->injectMtx);
+            pool->inject.push_back(item);
+            pool->injectSize.store(pool->inject.size(), std::memory_order_relaxed);
+        }
+        Wake_(pool);
+    }
+
+private:
+    static const int INJECT_BATCH = 32;//从注入队列一次最多搬到自己队列的任务数
+    static const int SPIN_ROUNDS = 2;//睡之前让出CPU再找几轮，提交方往往马上还有任务
+
+    struct Worker {
+        WorkDeque<Task> deque;
+        uint32_t rng;//选窃取起点用的xorshift状态，只有自己访问
+        char pad[64];
+    };
+
+    struct Pool {
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        std::mutex injectMtx;
+        std::deque<Task*> inject;//外部线程提交的任务
+        std::atomic<size_t> injectSize{0};//不加锁判断注入队列是否为空
+
+        std::mutex parkMtx;
+        std::condition_variable parkCond;
+        std::atomic<int> sleepers{0};//在parkCond上睡的线程数，为0时提交任务不用加锁通知
+        std::atomic<uint64_t> epoch{0};//每次唤醒加一，睡前记下来，锁里只比较它，不用在锁里扫所有队列
+        std::atomic<int> searching{0};//正在注入队列和别人队列里找任务的线程数
+        bool isClosed = false;//由parkMtx保护
+    };
+
+    struct Current {
+        Pool* pool;
+        int index;
+    };
+    static Current& Current_() {//当前线程是哪个池的第几个工作线程；头文件里的类没法直接定义thread_local静态成员
+        static thread_local Current current = {nullptr, 0};
+        return current;
+    }
+
+    //有线程正在找任务时不叫醒别人，它找到后如果是最后一个找任务的，再叫醒下一个，避免每提交一个任务就唤醒一次
+    static void Wake_(Pool* pool) {
+        //和Park_里的sleepers++、再检查一遍队列配对：要么这里看到有人在找或者在睡，要么睡的人看到新任务
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(pool->searching.load(std::memory_order_relaxed) == 0 && pool->sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            pool->epoch.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> locker(pool->parkMtx);
+            pool->parkCond.notify_one();
+        }
+    }
+
+    static bool HasWork_(Pool* pool) {
+        if(pool->injectSize.load(std::memory_order_relaxed) > 0)
+        {
+            return true;
+        }
+        for(auto& worker : pool->workers)
+        {
+            if(!worker->deque.Empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static Task* TakeInjected_(Pool* pool, Worker* self) {
+        if(pool->injectSize.load(std::memory_order_relaxed) == 0)
+        {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> locker(pool->injectMtx);
+        if(pool->inject.empty())
+        {
+            return nullptr;
+        }
+        Task* task = pool->inject.front();
+        pool->inject.pop_front();
+        //按工作线程数均分，剩下的留给别人，最多INJECT_BATCH个
+        size_t batch = pool->inject.size() / pool->workers.size();
+        if(batch > static_cast<size_t>(INJECT_BATCH))
+        {
+            batch = INJECT_BATCH;
+        }
+        for(size_t i = 0; i < batch; i++)
+        {
+            self->deque.Push(pool->inject.front());
+            pool->inject.pop_front();
+        }
+        pool->injectSize.store(pool->inject.size(), std::memory_order_relaxed);
+        return task;
+    }
+
+    static Task* StealOne_(Pool* pool, int index) {
+        Worker* self = pool->workers[index].get();
+        size_t n = pool->workers.size();
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 17;
+        self->rng ^= self->rng << 5;
+        size_t start = self->rng % n;
+        for(size_t i = 0; i < n; i++)
+        {
+            size_t victim = (start + i) % n;
+            if(victim == static_cast<size_t>(index))
+            {
+                continue;
+            }
+            Task* task = pool->workers[victim]->deque.Steal();
+            if(task)
+            {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    //睡之前再检查一遍，返回false表示池已关闭且没有任务了
+    static bool Park_(Pool* pool) {
+        uint64_t epoch = pool->epoch.load(std::memory_order_relaxed);
+        pool->sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool alive = true;
+        if(!HasWork_(pool))
+        {
+            std::unique_lock<std::mutex> locker(pool->parkMtx);
+            while(pool->epoch.load(std::memory_order_relaxed) == epoch && !pool->isClosed)
+            {
+                pool->parkCond.wait(locker);
+            }
+            alive = !pool->isClosed || HasWork_(pool);//关闭时把剩下的任务做完才退出
+        }
+        pool->sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return alive;
+    }
+
+    static void Run_(Pool* pool, int index) {
+        Current& current = Current_();
+        current.pool = pool;
+        current.index = index;
+        Worker* self = pool->workers[index].get();
+        while(true)
+        {
+            Task* task = self->deque.Pop();
+            if(!task)
+            {
+                pool->searching.fetch_add(1, std::memory_order_seq_cst);
+                for(int round = 0; !task && round <= SPIN_ROUNDS; round++)
+                {
+                    if(round > 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                    task = TakeInjected_(pool, self);
+                    if(!task)
+                    {
+                        task = StealOne_(pool, index);
+                    }
+                }
+                if(pool->searching.fetch_sub(1, std::memory_order_seq_cst) == 1 && task)
+                {
+                    Wake_(pool);
+                }
+            }
+            if(task)
+            {
+                (*task)();
+                delete task;
+                continue;
+            }
+            if(!Park_(pool))
+            {
+                break;
+            }
+        }
+        current.pool = nullptr;
+    }
+
+    std::shared_ptr<Pool> pool_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
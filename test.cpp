@@ -1,6 +1,24 @@
 #include "../TinyWebServer/log/log.h"
+#include "../TinyWebServer/buffer/lockfreequeue.h"
 #include "../TinyWebServer/poll/threadPool.h"
+#include "../TinyWebServer/poll/workstealingpool.h"
+#include "../TinyWebServer/httprequest/httpscan.h"
+#include "../TinyWebServer/httprequest/httprequest.h"
+#include "../TinyWebServer/poll/sqlconnpool.h"
+#include "../TinyWebServer/poll/sqlasync.h"
+#include "../TinyWebServer/userstore/memuserstore.h"
 #include <features.h>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
@@ -37,6 +55,26 @@ void ThreadLogTask(int i, int cnt) {
     }
 }
 
+//几个线程同时打异步日志，看写线程成批取、成批写之后每秒能落多少行
+void TestLogThroughput() {
+    const int threads = 4, lines = 50000;
+    Log::Instance()->init(1, "./testLogThroughput", ".log", 4096);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for(int t = 0; t < threads; t++) {
+        writers.emplace_back([t]() {
+            for(int i = 0; i < lines; i++) {
+                LOG_INFO("writer %d line %d ============= ", t, i);
+            }
+        });
+    }
+    for(std::thread& writer : writers) {
+        writer.join();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%d lines in %.3f s, %.2f M lines/s\n", threads * lines, sec, threads * lines / sec / 1e6);
+}
+
 void TestThreadPool() {
     Log::Instance()->init(0, "./testThreadpool", ".log", 5000);
     ThreadPool threadpool(6);
@@ -46,7 +84,774 @@ void TestThreadPool() {
     getchar();
 }
 
+//两种负载：外部线程连续提交小任务；任务在工作线程里再提交子任务（二叉树展开）
+template<typename POOL>
+static void RunPoolBench(POOL& pool, int external, int depth, long* externalUs, long* forkUs) {
+    typedef std::chrono::steady_clock Clock;
+    std::atomic<int> done(0);
+    auto start = Clock::now();
+    for(int i = 0; i < external; i++) {
+        pool.AddTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    while(done.load() < external) {
+        std::this_thread::yield();
+    }
+    *externalUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+    done = 0;
+    int total = (1 << (depth + 1)) - 1;
+    std::function<void(int)> spawn = [&](int level) {
+        done.fetch_add(1, std::memory_order_relaxed);
+        if(level > 0) {
+            pool.AddTask([&spawn, level]() { spawn(level - 1); });
+            pool.AddTask([&spawn, level]() { spawn(level - 1); });
+        }
+    };
+    start = Clock::now();
+    pool.AddTask([&spawn, depth]() { spawn(depth); });
+    while(done.load() < total) {
+        std::this_thread::yield();
+    }
+    *forkUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+//ThreadPool和WorkStealingPool在1~64个线程下的吞吐，单位：百万任务/秒
+void TestWorkStealing() {
+    const int external = 200000, depth = 17;
+    const double forkTasks = (1 << (depth + 1)) - 1;
+    printf("threads  ThreadPool(ext fork)  WorkStealing(ext fork)\n");
+    for(int threads = 1; threads <= 64; threads *= 2) {
+        long extUs[2], forkUs[2];
+        {
+            ThreadPool pool(threads);
+            RunPoolBench(pool, external, depth, &extUs[0], &forkUs[0]);
+        }
+        {
+            WorkStealingPool pool(threads);
+            RunPoolBench(pool, external, depth, &extUs[1], &forkUs[1]);
+        }
+        printf("%7d  %9.2f %9.2f  %11.2f %9.2f\n", threads,
+               external / double(extUs[0]), forkTasks / forkUs[0],
+               external / double(extUs[1]), forkTasks / forkUs[1]);
+    }
+}
+
+//一万个任务逐个AddTask和一次AddTasks的提交耗时；后台任务占满线程时前台任务的排队时间
+void TestThreadPoolBulk() {
+    typedef std::chrono::steady_clock Clock;
+    const int burst = 10000;
+    ThreadPool pool(4);
+    for(int round = 0; round < 3; round++) {
+        std::atomic<int> done(0);
+        auto start = Clock::now();
+        for(int i = 0; i < burst; i++) {
+            pool.AddTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        long singleUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        while(done.load() < burst) {
+            std::this_thread::yield();
+        }
+
+        done = 0;
+        std::vector<Task> tasks;
+        tasks.reserve(burst);
+        for(int i = 0; i < burst; i++) {
+            tasks.emplace_back([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        start = Clock::now();
+        pool.AddTasks(tasks);
+        long bulkUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        while(done.load() < burst) {
+            std::this_thread::yield();
+        }
+        printf("submit %d tasks: AddTask %ld us, AddTasks %ld us\n", burst, singleUs, bulkUs);
+    }
+
+    //先塞满后台任务，再提交一个前台任务，看它要等多久
+    std::vector<std::function<void()>> background(2000, []() { std::this_thread::sleep_for(std::chrono::microseconds(200)); });
+    pool.AddTasks(background, ThreadPool::BACKGROUND);
+    auto start = Clock::now();
+    std::future<long> waited = pool.Submit([start]() {
+        return (long)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    });
+    printf("foreground task behind %zu background tasks waited %ld us\n", background.size(), waited.get());
+}
+
+//弹性线程池：长任务把常驻线程占满后加线程，空闲超时后退回常驻线程数；CANCEL关闭丢掉没开始的任务
+void TestThreadPoolElastic() {
+    ThreadPool pool(2, 16, 500);
+    std::atomic<int> done(0);
+    for(int i = 0; i < 32; i++) {
+        pool.AddTask([&done]() { std::this_thread::sleep_for(std::chrono::milliseconds(50)); done++; });
+    }
+    printf("32 blocking tasks: %d threads\n", pool.ThreadCount());
+    while(done.load() < 32) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    printf("after 1s idle: %d threads\n", pool.ThreadCount());
+    for(int i = 0; i < 1000; i++) {
+        pool.AddTask([&done]() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); done++; });
+    }
+    size_t dropped = pool.Shutdown(ThreadPool::CANCEL);
+    printf("cancel: %zu dropped, %d ran\n", dropped, done.load() - 32);
+}
+
+//数一数operator new被调用了多少次，只在g_countNew打开时计数
+static std::atomic<bool> g_countNew(false);
+static std::atomic<long> g_newCount(0);
+
+void* operator new(size_t size) {
+    if(g_countNew.load(std::memory_order_relaxed)) {
+        g_newCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+//任务放在Task的内联存储里，TaskRing涨到工作大小之后，AddTask不再分配内存
+void TestTaskNoAlloc() {
+    const int count = 1000;
+    ThreadPool pool(1);
+    std::atomic<int> done(0);
+    for(int round = 0; round < 2; round++) {//第一轮让环形队列涨到够用，第二轮计数
+        done = 0;
+        g_newCount = 0;
+        g_countNew = round == 1;
+        for(int i = 0; i < count; i++) {
+            pool.AddTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while(done.load() < count) {
+            std::this_thread::yield();
+        }
+        g_countNew = false;
+    }
+    printf("%d AddTask calls: %ld allocations\n", count, g_newCount.load());
+}
+
+//打印几种放置策略在本机上的结果，以及工作线程和日志写线程实际绑到的核
+void TestPlacement(const char* ifname) {
+    printf("spread numa: %s\n", Placement::SpreadNuma().Describe().c_str());
+    printf("near %s: %s\n", ifname, Placement::NearNic(ifname).Describe().c_str());
+    ThreadPool pool(4, Placement::SpreadNuma());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));//等工作线程都绑好核
+    for(const ThreadPool::WorkerInfo& worker : pool.Workers()) {
+        printf("worker domain %d node %d cpus %s\n", worker.domain, worker.node, worker.cpus.c_str());
+    }
+    Log::Instance()->init(1, "./testPlacement", ".log", 1024, Placement::NearNic(ifname));
+    LOG_INFO("placement test");
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    printf("log writer cpus %s\n", Log::Instance()->WriterAffinity().c_str());
+}
+
+//一半任务很快一半要1ms，混着前后台提交，每200ms把统计快照写一次日志并打印出来
+void TestThreadPoolStats() {
+    Log::Instance()->init(1, "./testPoolStats", ".log", 1024);
+    ThreadPool pool(2, 8, 1000);
+    for(int round = 0; round < 5; round++) {
+        for(int i = 0; i < 500; i++) {
+            if(i % 2) {
+                pool.AddTask([]() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+            } else {
+                pool.AddTask([]() {}, ThreadPool::BACKGROUND);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::string line = pool.GetStats().ToString();
+        LOG_INFO("threadpool %s", line.c_str());
+        printf("%s\n", line.c_str());
+    }
+}
+
+//producers个线程各放perProducer个数，consumers个线程取，每个消费者最后收到一个-1退出，返回每秒经过队列的元素数
+template<typename Queue>
+static double QueueThroughput(int producers, int consumers, int perProducer) {
+    Queue queue(1024);
+    std::atomic<long> sum(0);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for(int c = 0; c < consumers; c++) {
+        threads.emplace_back([&queue, &sum]() {
+            long local = 0;
+            int item;
+            while(queue.pop(item) && item >= 0) {
+                local += item;
+            }
+            sum += local;
+        });
+    }
+    std::vector<std::thread> senders;
+    for(int p = 0; p < producers; p++) {
+        senders.emplace_back([&queue, perProducer]() {
+            for(int i = 0; i < perProducer; i++) {
+                queue.push_back(i & 0xff);
+            }
+        });
+    }
+    for(std::thread& sender : senders) {
+        sender.join();
+    }
+    for(int c = 0; c < consumers; c++) {
+        queue.push_back(-1);
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return producers * static_cast<double>(perProducer) / sec;
+}
+
+void TestLockFreeQueue() {
+    const int total = 2000000;
+    int counts[] = {1, 2, 4, 8};
+    for(int n : counts) {
+        double locked = QueueThroughput<BlockQueue<int>>(n, n, total / n);
+        double lockFree = QueueThroughput<LockFreeQueue<int>>(n, n, total / n);
+        printf("%d producers %d consumers: BlockQueue %6.2f M/s  LockFreeQueue %6.2f M/s\n",
+               n, n, locked / 1e6, lockFree / 1e6);
+    }
+}
+
+//线程池里的任务把结果放进带eventfd的队列，事件循环线程在epoll上等，醒来不等待地成批取走
+//看醒来的次数比结果数少多少：唤醒是合并的，忙的时候一次能取走很多
+void TestQueueEventFd() {
+    const int total = 200000;
+    BlockQueue<int> done(4096, true);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, done.event_fd(), &ev);
+
+    ThreadPool pool(4);
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < total; i++) {
+        pool.AddTask([&done, i]() { done.push_back(i); });
+    }
+    long sum = 0, wakeups = 0;
+    int got = 0;
+    std::vector<int> items;
+    while(got < total) {
+        epoll_event events[8];
+        if(epoll_wait(epfd, events, 8, 1000) <= 0) {
+            break;
+        }
+        wakeups++;
+        items.clear();
+        got += done.pop_bulk(items, 1024, 0);
+        for(int item : items) {
+            sum += item;
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%d results (sum ok: %d) in %.1f ms, %ld wakeups, %.1f results per wakeup\n",
+           got, sum == static_cast<long>(total) * (total - 1) / 2, ms, wakeups, got / static_cast<double>(wakeups));
+    close(epfd);
+}
+
+//典型浏览器请求头，用来测请求解析里逐行找"\r\n"和':'的开销
+static const char kBrowserRequest[] =
+    "GET /picture.html?from=index&lang=zh-CN HTTP/1.1\r\n"
+    "Host: www.example.com:1316\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Referer: http://www.example.com:1316/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: sessionid=6f1c0d8e2b7a4c3f9e5d1a0b8c7e6f5d; csrftoken=Qm9vdHN0cmFwU2Vzc2lvbklEMTIzNDU2Nzg5MA\r\n"
+    "\r\n";
+
+typedef const char* (*CRLFScan)(const char*, const char*);
+typedef const char* (*CharScan)(const char*, const char*, char);
+
+static const char* SearchCRLF(const char* begin, const char* end) {
+    const char CRLF[] = "\r\n";
+    const char* p = std::search(begin, end, CRLF, CRLF + 2);
+    return p;
+}
+
+static const char* SearchChar(const char* begin, const char* end, char c) {
+    return std::find(begin, end, c);
+}
+
+//按Parse的方式切一遍：逐行找行尾，每行再找':'，返回找到的分隔符数防止被优化掉
+static size_t ScanRequest(const char* begin, const char* end, CRLFScan crlf, CharScan chr) {
+    size_t found = 0;
+    while(begin < end) {
+        const char* lineEnd = crlf(begin, end);
+        found += chr(begin, lineEnd, ':') != lineEnd;
+        if(lineEnd == end) {
+            break;
+        }
+        begin = lineEnd + 2;
+    }
+    return found;
+}
+
+void TestHttpScan() {
+    const char* begin = kBrowserRequest;
+    const char* end = kBrowserRequest + sizeof(kBrowserRequest) - 1;
+    struct { const char* name; CRLFScan crlf; CharScan chr; } impls[] = {
+        {"std::search", SearchCRLF, SearchChar},
+        {"scalar", HttpScan::FindCRLFScalar, HttpScan::FindCharScalar},
+        {"sse2", HttpScan::FindCRLFSSE2, HttpScan::FindCharSSE2},
+        {"avx2", HttpScan::FindCRLFAVX2, HttpScan::FindCharAVX2},
+        {"dispatch", HttpScan::FindCRLF, HttpScan::FindChar},
+    };
+    const int rounds = 200000;
+    size_t expect = ScanRequest(begin, end, SearchCRLF, SearchChar);
+    printf("request %zu bytes, %zu header lines, dispatch=%s\n", (size_t)(end - begin), expect, HttpScan::ImplName());
+    for(auto& impl : impls) {
+        if(strcmp(impl.name, "avx2") == 0 && strcmp(HttpScan::ImplName(), "avx2") != 0) {
+            continue;//CPU不支持AVX2
+        }
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < rounds; i++) {
+            found += ScanRequest(begin, end, impl.crlf, impl.chr);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        assert(found == expect * rounds);
+        printf("%-12s %8.1f ns/request\n", impl.name, (double)ns / rounds);
+    }
+}
+
+//把data按每次step字节喂给Parse，模拟分多次ReadFd收到；返回Parse的结果，req停在最后的状态
+static bool FeedRequest(HttpRequest& req, Buffer& buf, const std::string& data, size_t step) {
+    for(size_t i = 0; i < data.size(); i += step) {
+        buf.Append(data.data() + i, std::min(step, data.size() - i));
+        if(!req.Parse(buf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//请求解析的行为：两种模式（普通/零拷贝）都要得到一样的结果
+void TestHttpParse() {
+    const std::string get = "GET /picture HTTP/1.1\r\nHost: a.example\r\nConnection: keep-alive\r\n\r\n";
+    const std::string chunked = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n";
+    for(int zeroCopy = 0; zeroCopy < 2; zeroCopy++) {
+        //一个请求分多次到达：每次只来3个字节，中间都不算完成
+        {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            assert(FeedRequest(req, buf, get.substr(0, get.size() - 1), 3));
+            assert(!req.IsFinished());
+            assert(FeedRequest(req, buf, get.substr(get.size() - 1), 1));
+            assert(req.IsFinished());
+            assert(req.Path() == "/picture.html");
+            assert(req.Header("host").ToString() == "a.example");
+            assert(req.IsKeepAlive());
+            assert(buf.ReadableBytes() == 0);
+        }
+        //一个Buffer里的N个流水线请求一次解析完，最后半个请求留给下一次
+        {
+            const int N = 8;
+            HttpRequest reqs[N + 1];
+            Buffer buf;
+            for(int i = 0; i < N + 1; i++) {
+                reqs[i].SetZeroCopy(zeroCopy);
+                std::string path = "/p" + std::to_string(i);
+                std::string body = i % 2 ? "body" + std::to_string(i) : "";
+                std::string req = "POST " + path + " HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) +
+                                  "\r\n\r\n" + body;
+                buf.Append(i < N ? req : req.substr(0, 10));
+            }
+            assert(HttpRequest::ParsePipeline(buf, reqs, N + 1) == N);
+            for(int i = 0; i < N; i++) {
+                assert(reqs[i].Path() == "/p" + std::to_string(i));
+                assert(reqs[i].Body().ToString() == (i % 2 ? "body" + std::to_string(i) : ""));
+            }
+            assert(!reqs[N].IsFinished());
+        }
+        //chunked请求体，逐字节到达
+        {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            assert(FeedRequest(req, buf, chunked, 1));
+            assert(req.IsFinished());
+            assert(req.Body().ToString() == "hello world");
+        }
+        //会让前后两跳切出不同请求的写法一律400
+        const char* bad[] = {
+            "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello",
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\ntransfer-encoding: chunked\r\n\r\n0\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length : 5\r\n\r\nhello",
+            "POST / HTTP/1.1\r\nContent-Length\t: 5\r\n\r\nhello",
+            "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+            "GET / HTTP/1.1\r\n: empty-name\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: 5x\r\n\r\nhello",
+        };
+        for(const char* data : bad) {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            assert(!FeedRequest(req, buf, data, strlen(data)));
+            assert(req.ErrorCode() == 400);
+        }
+        //一次读进来的完整长行也要拒绝
+        {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            std::string data = "GET / HTTP/1.1\r\nX-Long: " + std::string(9000, 'a') + "\r\n\r\n";
+            assert(!FeedRequest(req, buf, data, data.size()));
+        }
+        //请求体超过上限：413
+        const char* tooLarge[] = {
+            "POST / HTTP/1.1\r\nContent-Length: 999999999\r\n\r\n",
+            "POST /f HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: 2000000\r\n\r\n",
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n10000000\r\n",
+        };
+        for(const char* data : tooLarge) {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            assert(!FeedRequest(req, buf, data, strlen(data)));
+            assert(req.ErrorCode() == 413);
+        }
+        //表单字段数超过上限：Content-Length没超，解码时发现，也是413
+        {
+            HttpRequest req;
+            Buffer buf;
+            req.SetZeroCopy(zeroCopy);
+            std::string form;
+            for(int i = 0; i < 2000; i++) {
+                form += "k=v&";
+            }
+            std::string data = "POST /f HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                               std::to_string(form.size()) + "\r\n\r\n" + form;
+            assert(!FeedRequest(req, buf, data, data.size()));
+            assert(req.ErrorCode() == 413);
+        }
+    }
+    printf("http parse: all cases passed\n");
+}
+
+//keep-alive连接上重复解析同一种POST请求：请求状态放在Arena里，热身之后每个请求都不再分配内存
+void TestParseNoAlloc() {
+    const int count = 1000;
+    const std::string data = "POST /upload HTTP/1.1\r\nHost: a.example\r\nConnection: keep-alive\r\n"
+                             "Content-Type: text/plain\r\nX-Trace: 1234\r\nContent-Length: 11\r\n\r\nhello world";
+    for(int zeroCopy = 0; zeroCopy < 2; zeroCopy++) {
+        HttpRequest req;
+        Buffer buf(4096);
+        for(int round = 0; round < 2; round++) {//第一轮让Arena、Buffer、path_涨到够用，第二轮计数
+            g_newCount = 0;
+            g_countNew = round == 1;
+            for(int i = 0; i < count; i++) {
+                req.Init();
+                req.SetZeroCopy(zeroCopy);
+                buf.Append(data.data(), data.size());
+                bool ok = req.Parse(buf) && req.IsFinished();
+                assert(ok);
+                (void)ok;
+            }
+            g_countNew = false;
+        }
+        printf("%d keep-alive POST requests (%s): %ld allocations\n", count,
+               zeroCopy ? "zero-copy" : "owned", g_newCount.load());
+    }
+}
+
+//本地的mysqld替身：只实现握手和OK包，每个连接在发握手包之前等latencyMs，模拟远程数据库的往返延迟
+//认证一律通过，COM_QUIT关闭连接，其余命令都回OK
+class MysqldStandIn {
+public:
+    explicit MysqldStandIn(int latencyMs) : latencyMs_(latencyMs), stop_(false) {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        listen(listenFd_, 256);
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        acceptor_ = std::thread([this] { AcceptLoop(); });
+    }
+    ~MysqldStandIn() {
+        stop_ = true;
+        shutdown(listenFd_, SHUT_RDWR);
+        close(listenFd_);
+        acceptor_.join();
+        for(auto& t : sessions_) {
+            t.join();
+        }
+    }
+    int Port() const { return port_; }
+
+private:
+    static bool SendPacket(int fd, uint8_t seq, const std::string& payload) {
+        std::string pkt(4, '\0');
+        pkt[0] = static_cast<char>(payload.size() & 0xff);
+        pkt[1] = static_cast<char>((payload.size() >> 8) & 0xff);
+        pkt[2] = static_cast<char>((payload.size() >> 16) & 0xff);
+        pkt[3] = static_cast<char>(seq);
+        pkt += payload;
+        return write(fd, pkt.data(), pkt.size()) == static_cast<ssize_t>(pkt.size());
+    }
+    static bool ReadFull(int fd, char* buf, size_t len) {
+        while(len > 0) {
+            ssize_t n = read(fd, buf, len);
+            if(n <= 0) {
+                return false;
+            }
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+    static bool RecvPacket(int fd, uint8_t* seq, std::string* payload) {
+        char head[4];
+        if(!ReadFull(fd, head, 4)) {
+            return false;
+        }
+        size_t len = static_cast<uint8_t>(head[0]) | (static_cast<uint8_t>(head[1]) << 8) | (static_cast<uint8_t>(head[2]) << 16);
+        *seq = static_cast<uint8_t>(head[3]);
+        payload->resize(len);
+        return len == 0 || ReadFull(fd, &(*payload)[0], len);
+    }
+    static std::string OkPacket() {
+        return std::string("\x00\x00\x00\x02\x00\x00\x00", 7);//header, affected rows, insert id, status, warnings
+    }
+    void Session(int fd, uint32_t id) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latencyMs_));
+        std::string hello;
+        hello += '\x0a';//protocol 10
+        hello += "8.0.0-standin";
+        hello += '\0';
+        hello.append(reinterpret_cast<const char*>(&id), 4);
+        hello += "abcdefgh";//scramble part 1
+        hello += '\0';
+        hello += std::string("\x0f\xa2", 2);//capability lower: LONG_PASSWORD|FOUND_ROWS|LONG_FLAG|CONNECT_WITH_DB|PROTOCOL_41|TRANSACTIONS|SECURE_CONNECTION
+        hello += '\x21';//utf8
+        hello += std::string("\x02\x00", 2);//status: autocommit
+        hello += std::string("\x0a\x00", 2);//capability upper: MULTI_RESULTS|PLUGIN_AUTH
+        hello += '\x15';//auth data length 21
+        hello += std::string(10, '\0');
+        hello += "ijklmnopqrst";//scramble part 2
+        hello += '\0';
+        hello += "mysql_native_password";
+        hello += '\0';
+        uint8_t seq = 0;
+        std::string payload;
+        if(SendPacket(fd, 0, hello) && RecvPacket(fd, &seq, &payload) && SendPacket(fd, seq + 1, OkPacket())) {
+            while(RecvPacket(fd, &seq, &payload) && !payload.empty() && payload[0] != '\x01') {//COM_QUIT
+                SendPacket(fd, seq + 1, OkPacket());
+            }
+        }
+        close(fd);
+    }
+    void AcceptLoop() {
+        uint32_t id = 1;
+        while(!stop_) {
+            int fd = accept(listenFd_, nullptr, nullptr);
+            if(fd < 0) {
+                break;
+            }
+            sessions_.emplace_back([this, fd, id] { Session(fd, id); });
+            id++;
+        }
+    }
+
+    int latencyMs_;
+    int listenFd_;
+    int port_;
+    std::atomic<bool> stop_;
+    std::thread acceptor_;
+    std::vector<std::thread> sessions_;
+};
+
+//连接池启动耗时：原来的逐个连接 vs 并行Init vs 懒加载InitLazy
+void TestSqlPoolStartup() {
+    Log::Instance()->init(1, "./testSqlPool", ".log", 0);
+    const int latencyMs = 20, connSize = 32, lazyMin = 4;
+    MysqldStandIn server(latencyMs);
+    typedef std::chrono::steady_clock Clock;
+    auto ms = [](Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    auto start = Clock::now();
+    std::vector<MYSQL*> conns;
+    for(int i = 0; i < connSize; i++) {
+        MYSQL* conn = mysql_init(nullptr);
+        if(mysql_real_connect(conn, "127.0.0.1", "root", "root", "webserver", server.Port(), nullptr, 0)) {
+            conns.push_back(conn);
+        }
+        else {
+            mysql_close(conn);
+        }
+    }
+    printf("sequential   %2zu conns %5ld ms\n", conns.size(), (long)ms(start));
+    for(MYSQL* conn : conns) {
+        mysql_close(conn);
+    }
+
+    SqlConnPool* pool = SqlConnPool::Instance();
+    start = Clock::now();
+    pool->Init("127.0.0.1", server.Port(), "root", "root", "webserver", connSize);
+    printf("parallel     %2d conns %5ld ms\n", pool->GetConnNum(), (long)ms(start));
+    pool->ClosePool();
+
+    start = Clock::now();
+    pool->InitLazy("127.0.0.1", server.Port(), "root", "root", "webserver", lazyMin, connSize);
+    printf("lazy         %2d conns %5ld ms\n", pool->GetConnNum(), (long)ms(start));
+    pool->ClosePool();
+}
+
+//异步查询：需要本地mysqld（root/root，库webserver）
+//每条语句在服务端睡2ms，对比8个线程同步查询和2个事件循环线程挂200个连接异步查询
+void TestSqlAsync() {
+    Log::Instance()->init(1, "./testSqlAsync", ".log", 0);
+    const int total = 4000, syncThreads = 8, asyncConns = 200, asyncLoops = 2;
+    const char* sql = "SELECT SLEEP(0.002)";
+    typedef std::chrono::steady_clock Clock;
+    auto ms = [](Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    SqlConnPool* pool = SqlConnPool::Instance();
+    pool->Init("127.0.0.1", 3306, "root", "root", "webserver", syncThreads);
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    std::atomic<int> syncOk(0);
+    for(int t = 0; t < syncThreads; t++) {
+        threads.emplace_back([&]() {
+            for(int i = 0; i < total / syncThreads; i++) {
+                MYSQL* conn = nullptr;
+                SqlConnRAII raii(&conn, pool);
+                if(conn && mysql_query(conn, sql) == 0) {
+                    mysql_free_result(mysql_store_result(conn));
+                    syncOk++;
+                }
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    printf("sync  %d threads          %5d ok %6ld ms\n", syncThreads, syncOk.load(), (long)ms(start));
+    pool->ClosePool();
+
+    SqlAsync* async = SqlAsync::Instance();
+    async->Init("127.0.0.1", 3306, "root", "root", "webserver", asyncConns, asyncLoops);
+    for(int i = 0; i < 100 && async->Connected() < asyncConns; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    start = Clock::now();
+    std::atomic<int> asyncOk(0), done(0);
+    for(int i = 0; i < total; i++) {
+        async->Query(sql, [&](SqlResult& result) {
+            if(result.err == 0) {
+                asyncOk++;
+            }
+            done++;
+        });
+    }
+    while(done < total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printf("async %d loops x %d conns %5d ok %6ld ms\n", asyncLoops, async->Connected(), asyncOk.load(), (long)ms(start));
+    async->Close();
+}
+
+//进程内用户存储：注册、查询的耗时，以及重新打开（读快照+重放日志）的耗时
+void TestMemUserStore() {
+    Log::Instance()->init(1, "./testUserStore", ".log", 0);
+    const int users = 100000, threads = 8;
+    typedef std::chrono::steady_clock Clock;
+    auto us = [](Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    };
+    system("rm -rf ./testUserStore.db ./testUserStore.crash");
+
+    MemUserStore store;
+    store.Open("./testUserStore.db", false, 0);
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; t++) {
+        workers.emplace_back([&store, t]() {
+            for(int i = t; i < users; i += threads) {
+                store.Add("user" + std::to_string(i), "passwd" + std::to_string(i));
+            }
+        });
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    printf("add    %d users %8ld us, log %llu bytes\n", users, (long)us(start), (unsigned long long)store.LogBytes());
+
+    workers.clear();
+    std::atomic<int> found(0);
+    start = Clock::now();
+    for(int t = 0; t < threads; t++) {
+        workers.emplace_back([&store, &found, t]() {
+            std::string passwd;
+            for(int i = t; i < users; i += threads) {
+                found += store.Find("user" + std::to_string(i), &passwd);
+            }
+        });
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    long findUs = (long)us(start);
+    printf("find   %d users %8ld us, %.3f us/op per thread\n", found.load(), findUs, double(findUs) * threads / users);
+
+    //store还没关，日志还没进快照；复制一份目录模拟崩溃后重启，走日志重放
+    system("rm -rf ./testUserStore.crash && cp -r ./testUserStore.db ./testUserStore.crash");
+    MemUserStore replay;
+    start = Clock::now();
+    replay.Open("./testUserStore.crash", false, 0);
+    printf("replay %zu users %8ld us\n", replay.Size(), (long)us(start));
+    store.Close();
+
+    MemUserStore reopen;
+    start = Clock::now();
+    reopen.Open("./testUserStore.db", false, 0);
+    printf("reopen %zu users %8ld us\n", reopen.Size(), (long)us(start));
+}
+
 int main() {
     TestLog();
+    // TestLogThroughput();
     // TestThreadPool();
+    // TestWorkStealing();
+    // TestThreadPoolBulk();
+    // TestThreadPoolElastic();
+    // TestTaskNoAlloc();
+    // TestPlacement("eth0");
+    // TestThreadPoolStats();
+    // TestLockFreeQueue();
+    // TestQueueEventFd();
+    // TestHttpScan();
+    TestHttpParse();
+    // TestParseNoAlloc();
+    // TestSqlPoolStartup();
+    // TestSqlAsync();
+    // TestMemUserStore();
 }
@@ -0,0 +1,456 @@
+#include "memuserstore.h"
+#include "../log/log.h"
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+//记录格式（主机字节序）：校验和u32 | 用户名长度u16 | 密码长度u16 | 用户名 | 密码，校验和覆盖它后面的所有字节
+static const size_t RECORD_HEAD = 8;
+//快照文件开头：魔数 + 代号u64，后面是和日志一样的记录
+static const char SNAPSHOT_MAGIC[4] = {'U', 'S', 'N', 'P'};
+static const size_t SNAPSHOT_HEAD = 12;
+
+MemUserStore::MemUserStore() : sync_(false), snapshotSec_(0), logFd_(-1), gen_(0), logBytes_(0),
+                               dirty_(false), stop_(false) {}
+
+MemUserStore::~MemUserStore(){
+    Close();
+}
+
+MemUserStore::Shard& MemUserStore::ShardOf(const std::string& user){
+    return shards_[std::hash<std::string>()(user) % SHARDS];
+}
+
+//FNV-1a
+uint32_t MemUserStore::Checksum_(const char* data, size_t len){
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void MemUserStore::Encode_(const std::string& user, const std::string& passwd, std::string* out){
+    size_t start = out->size();
+    out->resize(start + RECORD_HEAD + user.size() + passwd.size());
+    char* p = &(*out)[start];
+    uint16_t userLen = static_cast<uint16_t>(user.size());
+    uint16_t pwdLen = static_cast<uint16_t>(passwd.size());
+    memcpy(p + 4, &userLen, 2);
+    memcpy(p + 6, &pwdLen, 2);
+    memcpy(p + RECORD_HEAD, user.data(), user.size());
+    memcpy(p + RECORD_HEAD + user.size(), passwd.data(), passwd.size());
+    uint32_t sum = Checksum_(p + 4, out->size() - start - 4);
+    memcpy(p, &sum, 4);
+}
+
+std::string MemUserStore::LogPath_(uint64_t gen) const{
+    return dir_ + "/log." + std::to_string(gen);
+}
+
+std::string MemUserStore::SnapshotPath_() const{
+    return dir_ + "/snapshot";
+}
+
+static bool ReadAll(const std::string& path, std::string* out){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+    out->clear();
+    char buf[65536];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        out->append(buf, n);
+    }
+    close(fd);
+    return n == 0;
+}
+
+static void SyncDir(const std::string& dir){
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+bool MemUserStore::Open(const std::string& dir, bool syncEachWrite, int snapshotSec){
+    Close();
+    for(Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        shard.users.clear();
+    }
+    dir_ = dir;
+    sync_ = syncEachWrite;
+    snapshotSec_ = snapshotSec;
+    gen_ = 0;
+    logBytes_ = 0;
+    if(dir_.empty())
+    {
+        return true;
+    }
+    if(mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST)
+    {
+        LOG_ERROR("MemUserStore mkdir %s error: %d", dir_.c_str(), errno);
+        return false;
+    }
+    if(!Load_())
+    {
+        return false;
+    }
+    stop_ = false;
+    bg_ = std::thread(&MemUserStore::Background_, this);
+    LOG_INFO("MemUserStore open %s: %zu users, log gen %llu", dir_.c_str(), Size(), (unsigned long long)gen_);
+    return true;
+}
+
+void MemUserStore::Close(){
+    if(bg_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> locker(bgMtx_);
+            stop_ = true;
+        }
+        bgCond_.notify_all();
+        bg_.join();
+    }
+    if(logFd_ >= 0)
+    {
+        if(logBytes_ > 0)//下次打开时只读快照
+        {
+            Snapshot();
+        }
+        std::lock_guard<std::mutex> locker(logMtx_);
+        fdatasync(logFd_);
+        close(logFd_);
+        logFd_ = -1;
+    }
+}
+
+bool MemUserStore::LoadFile_(const std::string& path, size_t skip, bool truncateTail){
+    std::string data;
+    if(!ReadAll(path, &data))
+    {
+        LOG_ERROR("MemUserStore read %s error: %d", path.c_str(), errno);
+        return false;
+    }
+    size_t pos = skip;
+    while(pos + RECORD_HEAD <= data.size())
+    {
+        uint32_t sum;
+        uint16_t userLen, pwdLen;
+        memcpy(&sum, &data[pos], 4);
+        memcpy(&userLen, &data[pos + 4], 2);
+        memcpy(&pwdLen, &data[pos + 6], 2);
+        size_t len = RECORD_HEAD + userLen + pwdLen;
+        if(pos + len > data.size() || Checksum_(&data[pos + 4], len - 4) != sum)
+        {
+            break;
+        }
+        std::string user(&data[pos + RECORD_HEAD], userLen);
+        Shard& shard = ShardOf(user);
+        shard.users[user].assign(&data[pos + RECORD_HEAD + userLen], pwdLen);
+        pos += len;
+    }
+    if(pos < data.size())
+    {
+        if(!truncateTail)
+        {
+            LOG_ERROR("MemUserStore %s corrupted at %zu", path.c_str(), pos);
+            return false;
+        }
+        //崩溃时写了一半的记录，截掉，后面从这里接着追加
+        LOG_WARN("MemUserStore truncate %s: %zu bytes torn", path.c_str(), data.size() - pos);
+        if(truncate(path.c_str(), pos) < 0)
+        {
+            LOG_ERROR("MemUserStore truncate %s error: %d", path.c_str(), errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MemUserStore::Load_(){
+    uint64_t snapGen = 0;
+    std::string head;
+    std::string snapPath = SnapshotPath_();
+    if(access(snapPath.c_str(), F_OK) == 0)
+    {
+        int fd = open(snapPath.c_str(), O_RDONLY | O_CLOEXEC);
+        char buf[SNAPSHOT_HEAD];
+        bool ok = fd >= 0 && read(fd, buf, SNAPSHOT_HEAD) == static_cast<ssize_t>(SNAPSHOT_HEAD) &&
+                  memcmp(buf, SNAPSHOT_MAGIC, 4) == 0;
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        if(!ok)
+        {
+            LOG_ERROR("MemUserStore bad snapshot %s", snapPath.c_str());
+            return false;
+        }
+        memcpy(&snapGen, buf + 4, 8);
+        if(!LoadFile_(snapPath, SNAPSHOT_HEAD, false))//快照是改名后才生效的，不会写了一半
+        {
+            return false;
+        }
+    }
+
+    std::vector<uint64_t> gens;
+    DIR* d = opendir(dir_.c_str());
+    if(!d)
+    {
+        LOG_ERROR("MemUserStore opendir %s error: %d", dir_.c_str(), errno);
+        return false;
+    }
+    while(struct dirent* entry = readdir(d))
+    {
+        const char* name = entry->d_name;
+        if(strncmp(name, "log.", 4) != 0 || !name[4])
+        {
+            continue;
+        }
+        char* end;
+        uint64_t gen = strtoull(name + 4, &end, 10);
+        if(*end == '\0')
+        {
+            gens.push_back(gen);
+        }
+    }
+    closedir(d);
+    std::sort(gens.begin(), gens.end());
+
+    uint64_t last = snapGen;
+    for(uint64_t gen : gens)
+    {
+        if(gen < snapGen)//已经在快照里了，上次删日志之前崩溃留下的
+        {
+            unlink(LogPath_(gen).c_str());
+            continue;
+        }
+        if(!LoadFile_(LogPath_(gen), 0, true))
+        {
+            return false;
+        }
+        last = gen;
+    }
+    std::lock_guard<std::mutex> locker(logMtx_);
+    return OpenLog_(last);
+}
+
+//调用者持有logMtx_
+bool MemUserStore::OpenLog_(uint64_t gen){
+    std::string path = LogPath_(gen);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        LOG_ERROR("MemUserStore open %s error: %d", path.c_str(), errno);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    SyncDir(dir_);//新建的文件名也要落盘
+    if(logFd_ >= 0)
+    {
+        fdatasync(logFd_);
+        close(logFd_);
+    }
+    logFd_ = fd;
+    gen_ = gen;
+    logBytes_ = st.st_size;
+    dirty_ = false;
+    return true;
+}
+
+//调用者持有用户名所在分片的锁
+bool MemUserStore::Append_(const std::string& user, const std::string& passwd){
+    std::string record;
+    Encode_(user, passwd, &record);
+    std::lock_guard<std::mutex> locker(logMtx_);
+    if(logFd_ < 0)//只在内存里
+    {
+        return dir_.empty();
+    }
+    size_t done = 0;
+    while(done < record.size())
+    {
+        ssize_t n = write(logFd_, record.data() + done, record.size() - done);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            LOG_ERROR("MemUserStore write log error: %d", errno);
+            if(done > 0 && ftruncate(logFd_, logBytes_) < 0)//不留下半条记录，否则恢复时后面的记录都会被截掉
+            {
+                LOG_ERROR("MemUserStore ftruncate log error: %d", errno);
+            }
+            return false;
+        }
+        done += n;
+    }
+    if(sync_)
+    {
+        fdatasync(logFd_);
+    }
+    else
+    {
+        dirty_ = true;
+    }
+    logBytes_ += record.size();
+    return true;
+}
+
+int MemUserStore::Find(const std::string& user, std::string* passwd){
+    Shard& shard = ShardOf(user);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.users.find(user);
+    if(it == shard.users.end())
+    {
+        return 0;
+    }
+    if(passwd)
+    {
+        *passwd = it->second;
+    }
+    return 1;
+}
+
+int MemUserStore::Add(const std::string& user, const std::string& passwd){
+    if(user.size() > MAX_FIELD || passwd.size() > MAX_FIELD)
+    {
+        return -1;
+    }
+    Shard& shard = ShardOf(user);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    if(shard.users.count(user))
+    {
+        return 0;
+    }
+    if(!Append_(user, passwd))//先落日志再对外可见
+    {
+        return -1;
+    }
+    shard.users.emplace(user, passwd);
+    return 1;
+}
+
+size_t MemUserStore::Size(){
+    size_t total = 0;
+    for(Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        total += shard.users.size();
+    }
+    return total;
+}
+
+bool MemUserStore::Snapshot(){
+    std::lock_guard<std::mutex> snapLocker(snapMtx_);
+    uint64_t gen;
+    {
+        //先切到新一代日志：之后的注册都进新日志，快照里有没有它们都不影响恢复
+        std::lock_guard<std::mutex> locker(logMtx_);
+        if(logFd_ < 0)
+        {
+            return dir_.empty();
+        }
+        if(!OpenLog_(gen_ + 1))
+        {
+            return false;
+        }
+        gen = gen_;
+    }
+
+    std::string tmpPath = SnapshotPath_() + ".tmp";
+    FILE* fp = fopen(tmpPath.c_str(), "wbe");
+    if(!fp)
+    {
+        LOG_ERROR("MemUserStore open %s error: %d", tmpPath.c_str(), errno);
+        return false;
+    }
+    char head[SNAPSHOT_HEAD];
+    memcpy(head, SNAPSHOT_MAGIC, 4);
+    memcpy(head + 4, &gen, 8);
+    bool ok = fwrite(head, 1, SNAPSHOT_HEAD, fp) == SNAPSHOT_HEAD;
+    std::string records;
+    size_t count = 0;
+    for(Shard& shard : shards_)
+    {
+        records.clear();
+        {
+            std::lock_guard<std::mutex> locker(shard.mtx);//每次只锁一个分片，编码完就放开
+            for(auto& user : shard.users)
+            {
+                Encode_(user.first, user.second, &records);
+            }
+            count += shard.users.size();
+        }
+        ok = ok && fwrite(records.data(), 1, records.size(), fp) == records.size();
+    }
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if(!ok || rename(tmpPath.c_str(), SnapshotPath_().c_str()) < 0)
+    {
+        LOG_ERROR("MemUserStore write snapshot error: %d", errno);
+        unlink(tmpPath.c_str());
+        return false;//旧快照和所有日志都还在，恢复不受影响
+    }
+    SyncDir(dir_);
+    unlink(LogPath_(gen - 1).c_str());
+    LOG_INFO("MemUserStore snapshot: %zu users, log gen %llu", count, (unsigned long long)gen);
+    return true;
+}
+
+void MemUserStore::Background_(){
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point nextSnapshot = Clock::now() + std::chrono::seconds(snapshotSec_);
+    std::unique_lock<std::mutex> locker(bgMtx_);
+    while(!stop_)
+    {
+        bgCond_.wait_for(locker, std::chrono::seconds(1));
+        if(stop_)
+        {
+            break;
+        }
+        locker.unlock();
+        int fd = -1;
+        {
+            std::lock_guard<std::mutex> logLocker(logMtx_);
+            if(dirty_ && logFd_ >= 0)
+            {
+                fd = dup(logFd_);//在锁外刷盘，不挡住注册
+                dirty_ = false;
+            }
+        }
+        if(fd >= 0)
+        {
+            fdatasync(fd);
+            close(fd);
+        }
+        if(snapshotSec_ > 0 && Clock::now() >= nextSnapshot)
+        {
+            if(logBytes_ > 0)
+            {
+                Snapshot();
+            }
+            nextSnapshot = Clock::now() + std::chrono::seconds(snapshotSec_);
+        }
+        locker.lock();
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef MEMUSERSTORE_H
+#define MEMUSERSTORE_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+#include "userstore.h"
+
+// 进程内引擎：用户放在按用户名分片的哈希表里，查询不出进程，微秒级
+// 持久化：每次注册先追加一条记录到日志log.<代>，再放进哈希表；后台线程定期把整张表写成快照snapshot，
+// 写快照之前先切到下一代日志，快照落盘改名成功后删掉上一代日志
+// 恢复：读快照（记着它的代号G），再按顺序重放所有代号不小于G的日志；用户只增不改，重复记录无害
+// 日志末尾写了一半的记录（进程崩溃）按校验和识别出来截掉
+// dir为空串时只在内存里，不持久化
+class MemUserStore : public UserStore {
+public:
+    static const size_t SHARDS = 64;
+    static const size_t MAX_FIELD = 65535;//用户名和密码的最大长度
+
+    MemUserStore();
+    ~MemUserStore();
+
+    //syncEachWrite为true时每条日志都fdatasync，否则交给后台线程每秒一次；snapshotSec<=0时不定期写快照
+    bool Open(const std::string& dir, bool syncEachWrite = false, int snapshotSec = 300);
+    void Close();//写最后一个快照，停掉后台线程
+
+    int Find(const std::string& user, std::string* passwd) override;
+    int Add(const std::string& user, const std::string& passwd) override;
+
+    bool Snapshot();//立即写一个快照
+    size_t Size();
+    uint64_t LogBytes() { return logBytes_.load(std::memory_order_relaxed); }//当前这一代日志的大小
+
+private:
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, std::string> users;
+        char pad[64];//分片的锁不共享缓存行
+    };
+
+    Shard& ShardOf(const std::string& user);
+    std::string LogPath_(uint64_t gen) const;
+    std::string SnapshotPath_() const;
+    bool Load_();//读快照和日志
+    bool LoadFile_(const std::string& path, size_t skip, bool truncateTail);//解析记录放进表里
+    bool OpenLog_(uint64_t gen);
+    bool Append_(const std::string& user, const std::string& passwd);
+    void Background_();
+
+    static void Encode_(const std::string& user, const std::string& passwd, std::string* out);
+    static uint32_t Checksum_(const char* data, size_t len);
+
+    Shard shards_[SHARDS];
+
+    std::string dir_;
+    bool sync_;
+    int snapshotSec_;
+
+    std::mutex logMtx_;//保护日志fd和代号，加锁顺序：分片锁 -> logMtx_
+    int logFd_;
+    uint64_t gen_;//当前日志的代号
+    std::atomic<uint64_t> logBytes_;
+    bool dirty_;//上次fdatasync之后有没有新写入，由logMtx_保护
+
+    std::mutex snapMtx_;//同一时间只写一个快照
+
+    std::mutex bgMtx_;
+    std::condition_variable bgCond_;
+    bool stop_;
+    std::thread bg_;
+};
+
+#endif
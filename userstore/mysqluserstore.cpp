@@ -0,0 +1,36 @@
+#include "mysqluserstore.h"
+#include "../poll/sqlconnpool.h"
+#include "../poll/userbatcher.h"
+
+MySqlUserStore* MySqlUserStore::Instance(){
+    static MySqlUserStore store;
+    return &store;
+}
+
+int MySqlUserStore::Find(const std::string& user, std::string* passwd){
+    UserBatcher* batcher = UserBatcher::Instance();
+    if(batcher->Enabled())//和同一时间窗口内的其他查询合并成一次
+    {
+        return batcher->Lookup(user, passwd);
+    }
+    MYSQL* sql = nullptr;
+    SqlConnPool* pool = SqlConnPool::Instance();
+    SqlConnRAII raii(&sql, pool);
+    if(!sql)
+    {
+        return -1;
+    }
+    return pool->QueryUser(sql, user, passwd);
+}
+
+int MySqlUserStore::Add(const std::string& user, const std::string& passwd){
+    MYSQL* sql = nullptr;
+    SqlConnPool* pool = SqlConnPool::Instance();
+    SqlConnRAII raii(&sql, pool);
+    if(!sql)
+    {
+        return -1;
+    }
+    //直接插入，由username上的唯一键判断是否已存在；先查再插在两个请求同时注册同一个名字时会都插进去
+    return pool->InsertUser(sql, user, passwd);
+}
@@ -0,0 +1,20 @@
+#ifndef MYSQLUSERSTORE_H
+#define MYSQLUSERSTORE_H
+
+#include "userstore.h"
+
+// MySQL引擎：用户表在数据库里，连接从SqlConnPool借
+// 查询走连接上缓存的预处理语句；UserBatcher打开时登录查询合并成批
+// user表的username列要有唯一键（PRIMARY KEY或UNIQUE），Add靠它判断用户名已存在
+class MySqlUserStore : public UserStore {
+public:
+    static MySqlUserStore* Instance();
+
+    int Find(const std::string& user, std::string* passwd) override;
+    int Add(const std::string& user, const std::string& passwd) override;
+
+private:
+    MySqlUserStore() = default;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "userstore.h"
+#include "mysqluserstore.h"
+
+std::atomic<UserStore*> UserStore::current_(nullptr);
+
+UserStore* UserStore::Instance(){
+    UserStore* store = current_.load(std::memory_order_acquire);
+    return store ? store : MySqlUserStore::Instance();
+}
+
+void UserStore::Use(UserStore* store){
+    current_.store(store, std::memory_order_release);
+}
@@ -0,0 +1,24 @@
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <string>
+#include <atomic>
+
+// 用户存储接口：UserVerify只通过它查用户、注册用户，不再直接依赖libmysqlclient
+// 两个实现：MySqlUserStore（原来的MySQL表，默认）和MemUserStore（进程内哈希表，追加日志+定期快照持久化）
+// 实现必须是线程安全的
+class UserStore {
+public:
+    virtual ~UserStore() = default;
+
+    virtual int Find(const std::string& user, std::string* passwd) = 0;//找到返回1，没有返回0，出错返回-1
+    virtual int Add(const std::string& user, const std::string& passwd) = 0;//插入返回1，用户名已存在返回0，出错返回-1
+
+    static UserStore* Instance();//当前使用的存储，没有设置过时是MySqlUserStore
+    static void Use(UserStore* store);//不转移所有权，store要活到不再使用为止；传nullptr恢复默认
+
+private:
+    static std::atomic<UserStore*> current_;
+};
+
+#endif